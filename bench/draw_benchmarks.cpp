@@ -0,0 +1,418 @@
+// Copyright (c) 2023 Jacob R. Green
+// All Rights Reserved.
+
+// Draw call benchmarks running on the headless offscreen target.
+//
+// Text and bitmap benchmarks need assets, set XGDI_BENCH_FONT to a font file
+// and XGDI_BENCH_BITMAP to an image file to enable them.
+
+#include <benchmark/benchmark.h>
+
+#include <muchcool/xgdi.hpp>
+
+#include <cstdlib>
+#include <random>
+#include <string>
+
+using namespace muchcool;
+using namespace muchcool::xgdi;
+
+constexpr uint32 TargetWidth = 1920;
+constexpr uint32 TargetHeight = 1080;
+
+struct Headless {
+  Shared<rndr::GraphicsContext> context;
+  Shared<OffscreenTarget> target;
+  Shared<DrawingContext> drawing;
+  std::vector<uint8> pixels;
+};
+
+static Headless& headless() {
+  static auto instance = [] {
+    auto context = Shared{new rndr::GraphicsContext()};
+    auto target =
+        Shared{new OffscreenTarget(context, TargetWidth, TargetHeight)};
+    auto drawing = Shared{new DrawingContext(target)};
+    return Headless{context, target, drawing,
+                    std::vector<uint8>(TargetWidth * TargetHeight * 4)};
+  }();
+  return instance;
+}
+
+static std::vector<Rect> random_rects(size_t count) {
+  auto random = std::mt19937{42};
+  auto x = std::uniform_real_distribution<float>(0.0f, TargetWidth);
+  auto y = std::uniform_real_distribution<float>(0.0f, TargetHeight);
+  auto size = std::uniform_real_distribution<float>(4.0f, 256.0f);
+
+  auto rects = std::vector<Rect>(count);
+  for (auto& rect : rects) {
+    rect = Rect{{x(random), y(random)}, {size(random), size(random)}};
+  }
+  return rects;
+}
+
+static const char* asset(const char* variable) { return std::getenv(variable); }
+
+// Reports draws per second and recording time per draw.
+static void set_draw_counters(benchmark::State& state, int64_t draws) {
+  state.SetItemsProcessed(state.iterations() * draws);
+  state.counters["time/draw"] =
+      benchmark::Counter(static_cast<double>(draws),
+                         benchmark::Counter::kIsIterationInvariantRate |
+                             benchmark::Counter::kInvert);
+}
+
+template <typename Draw>
+static void record_frame(DrawingContext& drawing, Draw&& draw) {
+  drawing.reset();
+  drawing.start_recording();
+  draw();
+  drawing.end_recording();
+}
+
+static void submit_frame(Headless& headless) {
+  headless.drawing->submit();
+  headless.target->read_pixels(headless.pixels).get();
+}
+
+static void BM_RecordRectangle(benchmark::State& state) {
+  auto& drawing = *headless().drawing;
+  auto rects = random_rects(state.range(0));
+
+  for (auto _ : state) {
+    record_frame(drawing, [&] {
+      for (auto& rect : rects) drawing.draw_rectangle(rect, Color::Red);
+    });
+  }
+
+  set_draw_counters(state, state.range(0));
+}
+BENCHMARK(BM_RecordRectangle)->Arg(1000);
+
+static void BM_RecordRoundRectangle(benchmark::State& state) {
+  auto& drawing = *headless().drawing;
+  auto rects = random_rects(state.range(0));
+  const auto stroke = static_cast<float>(state.range(1));
+
+  for (auto _ : state) {
+    record_frame(drawing, [&] {
+      for (auto& rect : rects) {
+        drawing.draw_rectangle(rect, Size(8.0f), Color::Blue, Color::Black,
+                               stroke);
+      }
+    });
+  }
+
+  set_draw_counters(state, state.range(0));
+}
+BENCHMARK(BM_RecordRoundRectangle)
+    ->ArgsProduct({{1000}, {0, 2}})
+    ->ArgNames({"draws", "stroke"});
+
+static void BM_RecordLine(benchmark::State& state) {
+  auto& drawing = *headless().drawing;
+  auto rects = random_rects(state.range(0));
+
+  for (auto _ : state) {
+    record_frame(drawing, [&] {
+      for (auto& rect : rects) {
+        drawing.draw_line(rect.Offset, rect.Offset + rect.Size, Color::Green,
+                          2.0f);
+      }
+    });
+  }
+
+  set_draw_counters(state, state.range(0));
+}
+BENCHMARK(BM_RecordLine)->Arg(1000);
+
+static void BM_RecordPolyline(benchmark::State& state) {
+  auto& drawing = *headless().drawing;
+  auto rects = random_rects(state.range(0));
+
+  auto points = std::vector<Point>{};
+  for (auto& rect : rects) points.emplace_back(rect.Offset);
+
+  for (auto _ : state) {
+    record_frame(drawing, [&] {
+      drawing.draw_polyline(points, Color::Green, {.Thickness = 2.0f});
+    });
+  }
+
+  // One draw per frame, however many points it strokes.
+  set_draw_counters(state, 1);
+  state.counters["points/s"] =
+      benchmark::Counter(static_cast<double>(points.size()),
+                         benchmark::Counter::kIsIterationInvariantRate);
+}
+BENCHMARK(BM_RecordPolyline)->Arg(1000)->Arg(100000);
+
+static void BM_RecordBitmap(benchmark::State& state) {
+  auto path = asset("XGDI_BENCH_BITMAP");
+  if (!path) {
+    state.SkipWithError("XGDI_BENCH_BITMAP is not set.");
+    return;
+  }
+
+  auto& drawing = *headless().drawing;
+  auto bitmap = Shared{new Bitmap(headless().context, path)};
+  auto rects = random_rects(state.range(0));
+
+  for (auto _ : state) {
+    record_frame(drawing, [&] {
+      for (auto& rect : rects) drawing.draw_bitmap(rect, *bitmap);
+    });
+  }
+
+  set_draw_counters(state, state.range(0));
+}
+BENCHMARK(BM_RecordBitmap)->Arg(1000);
+
+static void BM_RecordFormattedText(benchmark::State& state) {
+  auto path = asset("XGDI_BENCH_FONT");
+  if (!path) {
+    state.SkipWithError("XGDI_BENCH_FONT is not set.");
+    return;
+  }
+
+  auto& drawing = *headless().drawing;
+  auto font = Font::Load(headless().context, path, 14.0f);
+
+  auto string = std::string(state.range(0), ' ');
+  for (size_t i = 0; i < string.size(); ++i) string[i] = 'a' + i % 26;
+  auto text = FormattedText(font, string.c_str());
+
+  for (auto _ : state) {
+    record_frame(drawing, [&] {
+      drawing.draw_formatted_text({16.0f, 16.0f}, text);
+    });
+  }
+
+  set_draw_counters(state, state.range(0));
+}
+BENCHMARK(BM_RecordFormattedText)->RangeMultiplier(8)->Range(8, 512);
+
+static void BM_FrameRectangles(benchmark::State& state) {
+  auto& instance = headless();
+  auto& drawing = *instance.drawing;
+  auto rects = random_rects(state.range(0));
+
+  for (auto _ : state) {
+    record_frame(drawing, [&] {
+      for (auto& rect : rects) drawing.draw_rectangle(rect, Color::Red);
+    });
+    submit_frame(instance);
+  }
+
+  set_draw_counters(state, state.range(0));
+}
+BENCHMARK(BM_FrameRectangles)
+    ->Arg(1000)
+    ->Arg(10000)
+    ->Arg(100000)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// Like BM_FrameRectangles without the readback. Frames still run one at a
+// time, reset waits for the previous frame.
+static void BM_FrameRectanglesNoReadback(benchmark::State& state) {
+  auto& instance = headless();
+  auto& drawing = *instance.drawing;
+  auto rects = random_rects(state.range(0));
+
+  for (auto _ : state) {
+    record_frame(drawing, [&] {
+      for (auto& rect : rects) drawing.draw_rectangle(rect, Color::Red);
+    });
+    drawing.submit();
+  }
+
+  set_draw_counters(state, state.range(0));
+}
+BENCHMARK(BM_FrameRectanglesNoReadback)
+    ->Arg(1000)
+    ->Arg(10000)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+static void BM_FrameRoundRectangles(benchmark::State& state) {
+  auto& instance = headless();
+  auto& drawing = *instance.drawing;
+  auto rects = random_rects(state.range(0));
+
+  for (auto _ : state) {
+    record_frame(drawing, [&] {
+      for (auto& rect : rects) {
+        drawing.draw_rectangle(rect, Size(8.0f), Color::Blue);
+      }
+    });
+    submit_frame(instance);
+  }
+
+  set_draw_counters(state, state.range(0));
+}
+BENCHMARK(BM_FrameRoundRectangles)
+    ->Arg(1000)
+    ->Arg(10000)
+    ->Arg(100000)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+static void BM_FrameLines(benchmark::State& state) {
+  auto& instance = headless();
+  auto& drawing = *instance.drawing;
+  auto rects = random_rects(state.range(0));
+
+  for (auto _ : state) {
+    record_frame(drawing, [&] {
+      for (auto& rect : rects) {
+        drawing.draw_line(rect.Offset, rect.Offset + rect.Size, Color::Green,
+                          2.0f);
+      }
+    });
+    submit_frame(instance);
+  }
+
+  set_draw_counters(state, state.range(0));
+}
+BENCHMARK(BM_FrameLines)
+    ->Arg(1000)
+    ->Arg(10000)
+    ->Arg(100000)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// One line of text per draw, 64 characters each.
+static std::string text_line() {
+  auto string = std::string(64, ' ');
+  for (size_t i = 0; i < string.size(); ++i) string[i] = 'a' + i % 26;
+  return string;
+}
+
+static void BM_FrameFormattedText(benchmark::State& state) {
+  auto path = asset("XGDI_BENCH_FONT");
+  if (!path) {
+    state.SkipWithError("XGDI_BENCH_FONT is not set.");
+    return;
+  }
+
+  auto& instance = headless();
+  auto& drawing = *instance.drawing;
+  auto font = Font::Load(instance.context, path, 14.0f);
+  auto text = FormattedText(font, text_line().c_str());
+  auto rects = random_rects(state.range(0));
+
+  for (auto _ : state) {
+    record_frame(drawing, [&] {
+      for (auto& rect : rects) drawing.draw_formatted_text(rect.Offset, text);
+    });
+    submit_frame(instance);
+  }
+
+  set_draw_counters(state, state.range(0));
+}
+BENCHMARK(BM_FrameFormattedText)
+    ->Arg(10)
+    ->Arg(100)
+    ->Arg(1000)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// The CPU frame benchmarks mirror the GPU ones above draw for draw.
+template <typename Draw>
+static void cpu_frame(CpuDrawingContext& drawing, Draw&& draw) {
+  drawing.reset();
+  drawing.start_recording();
+  draw();
+  drawing.end_recording();
+}
+
+static void BM_CpuFrameRectangles(benchmark::State& state) {
+  auto drawing = CpuDrawingContext(TargetWidth, TargetHeight);
+  auto rects = random_rects(state.range(0));
+
+  for (auto _ : state) {
+    cpu_frame(drawing, [&] {
+      for (auto& rect : rects) drawing.draw_rectangle(rect, Color::Red);
+    });
+  }
+
+  set_draw_counters(state, state.range(0));
+}
+BENCHMARK(BM_CpuFrameRectangles)
+    ->Arg(1000)
+    ->Arg(10000)
+    ->Arg(100000)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+static void BM_CpuFrameRoundRectangles(benchmark::State& state) {
+  auto drawing = CpuDrawingContext(TargetWidth, TargetHeight);
+  auto rects = random_rects(state.range(0));
+
+  for (auto _ : state) {
+    cpu_frame(drawing, [&] {
+      for (auto& rect : rects) {
+        drawing.draw_rectangle(rect, Size(8.0f), Color::Blue);
+      }
+    });
+  }
+
+  set_draw_counters(state, state.range(0));
+}
+BENCHMARK(BM_CpuFrameRoundRectangles)
+    ->Arg(1000)
+    ->Arg(10000)
+    ->Arg(100000)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+static void BM_CpuFrameLines(benchmark::State& state) {
+  auto drawing = CpuDrawingContext(TargetWidth, TargetHeight);
+  auto rects = random_rects(state.range(0));
+
+  for (auto _ : state) {
+    cpu_frame(drawing, [&] {
+      for (auto& rect : rects) {
+        drawing.draw_line(rect.Offset, rect.Offset + rect.Size, Color::Green,
+                          2.0f);
+      }
+    });
+  }
+
+  set_draw_counters(state, state.range(0));
+}
+BENCHMARK(BM_CpuFrameLines)
+    ->Arg(1000)
+    ->Arg(10000)
+    ->Arg(100000)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+static void BM_CpuFrameFormattedText(benchmark::State& state) {
+  auto path = asset("XGDI_BENCH_FONT");
+  if (!path) {
+    state.SkipWithError("XGDI_BENCH_FONT is not set.");
+    return;
+  }
+
+  auto drawing = CpuDrawingContext(TargetWidth, TargetHeight);
+  auto font = Font::Load(nullptr, path, 14.0f);
+  auto text = FormattedText(font, text_line().c_str());
+  auto rects = random_rects(state.range(0));
+
+  for (auto _ : state) {
+    cpu_frame(drawing, [&] {
+      for (auto& rect : rects) drawing.draw_formatted_text(rect.Offset, text);
+    });
+  }
+
+  set_draw_counters(state, state.range(0));
+}
+BENCHMARK(BM_CpuFrameFormattedText)
+    ->Arg(10)
+    ->Arg(100)
+    ->Arg(1000)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
@@ -3,7 +3,13 @@
 
 #pragma once
 
+#include "xgdi/cpu_drawing_context.hpp"
 #include "xgdi/datatypes.hpp"
 #include "xgdi/drawing_context.hpp"
 #include "xgdi/font.hpp"
-#include "xgdi/formatted_text.hpp"
\ No newline at end of file
+#include "xgdi/formatted_text.hpp"
+#include "xgdi/frame_stats.hpp"
+#include "xgdi/frame_trace.hpp"
+#include "xgdi/layer.hpp"
+#include "xgdi/offscreen_target.hpp"
+#include "xgdi/path.hpp"
\ No newline at end of file
@@ -6,21 +6,41 @@
 
 #include "datatypes.hpp"
 
+#include <atomic>
+#include <mutex>
+
 namespace muchcool::xgdi {
 
 class Bitmap : public rndr::GraphicsObject {
-  Shared<rndr::Texture> _texture;
+  // Created on first draw, drawing takes a const bitmap.
+  mutable Shared<rndr::Texture> _texture;
+  mutable std::once_flag _textureOnce;
+  mutable std::atomic<bool> _hasTexture = false;
+  std::vector<uint32> _pixels;
+  std::string _path;
 
   uint32 _width;
   uint32 _height;
+  bool _opaque;
 
  public:
   Bitmap(Shared<rndr::GraphicsContext> context, const char* path);
 
   auto GetWidth() const { return _width; }
   auto GetHeight() const { return _height; }
+  auto IsOpaque() const { return _opaque; }
+  auto& GetPath() const { return _path; }
 
+  // Null until CreateTexture has been called.
   auto& GetTexture() const { return _texture; }
+  bool HasTexture() const {
+    return _hasTexture.load(std::memory_order_acquire);
+  }
+  // Uploads the pixels once, safe to call from multiple threads. Callers
+  // serialize it with other submits to the context's queue.
+  void CreateTexture() const;
+  // RGBA8 pixels, row major.
+  auto& GetPixels() const { return _pixels; }
 };
 
 }  // namespace muchcool::xgdi
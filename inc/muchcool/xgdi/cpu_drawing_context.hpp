@@ -0,0 +1,100 @@
+// Copyright (c) 2023 Jacob R. Green
+// All Rights Reserved.
+
+#pragma once
+
+#include "bitmap.hpp"
+#include "datatypes.hpp"
+#include "formatted_text.hpp"
+#include "path.hpp"
+
+#include <thread>
+
+namespace muchcool::xgdi {
+
+enum class _CpuDrawType { Rectangle, RoundRect, Glyph, Bitmap, Triangles };
+
+struct _CpuDrawCommand {
+  _CpuDrawType Type;
+  Rect Bounds;
+  Color Fill;
+  Color Stroke;
+  Size Radius;
+  float StrokeThickness;
+  const Glyph* GlyphSource;
+  const Bitmap* BitmapSource;
+  // Triangle list in _vertices, for Triangles.
+  uint32 FirstVertex;
+  uint32 VertexCount;
+};
+
+// Software rasterizer exposing the drawing API of DrawingContext, for
+// rendering without Vulkan and as a reference for the GPU shaders. Draws are
+// recorded and rasterized in tiles across threads by end_recording.
+class CpuDrawingContext final : public Object {
+  uint32 _width;
+  uint32 _height;
+  uint32 _threadCount;
+
+  std::vector<uint32> _pixels;
+  std::vector<_CpuDrawCommand> _commands;
+  std::vector<Point> _vertices;
+  // Glyphs referenced by _commands, kept out of font cache eviction until
+  // the next frame.
+  std::vector<Shared<Glyph>> _glyphs;
+
+  // Indices of the commands overlapping each tile, in draw order. The
+  // commands of tile i are _tileCommands[_tileOffsets[i]] up to
+  // _tileCommands[_tileOffsets[i + 1]].
+  std::vector<uint32> _tileOffsets;
+  std::vector<uint32> _tileCommands;
+
+ public:
+  CpuDrawingContext(uint32 width, uint32 height,
+                    uint32 threadCount = std::thread::hardware_concurrency());
+  CpuDrawingContext(CpuDrawingContext&&) = delete;
+  CpuDrawingContext(const CpuDrawingContext&) = delete;
+
+  auto width() const { return _width; }
+  auto height() const { return _height; }
+
+  // RGBA8 pixels, row major, valid after end_recording.
+  auto& pixels() const { return _pixels; }
+
+  void reset();
+
+  void start_recording();
+  void end_recording();
+
+  void draw_rectangle(const Rect& rect, const Color& color);
+
+  void draw_line(const Point& start, const Point& end, const Color& color,
+                 float thickness = 1.0f);
+
+  void draw_rectangle(const Rect& rect, const Size& radius, const Color& fill,
+                      const Color& stroke = {}, float strokeThickness = 0);
+
+  // Tessellated like DrawingContext::draw_polyline, each pixel blends once.
+  void draw_polyline(ArrayProxy<const Point> points, const Color& color,
+                     const StrokeStyle& style = {});
+
+  // Tessellated like DrawingContext::draw_path, each pixel of the fill and
+  // of the stroke blends once.
+  void draw_path(const Path& path, const Color& fill, const Color& stroke = {},
+                 const StrokeStyle& style = {});
+
+  void draw_formatted_text(const Point& point, const FormattedText& text,
+                           const Color& color = Color::Black);
+
+  void draw_bitmap(const Rect& rect, const Bitmap& bitmap);
+
+ private:
+  // Adds a Triangles command for the vertices from `first` to the end.
+  void draw_triangles(size_t first, const Color& color);
+
+  void bin_commands(uint32 tilesX, uint32 tilesY);
+  void rasterize_tile(uint32 tile, uint32 x0, uint32 y0, uint32 x1,
+                      uint32 y1);
+};
+
+}  // namespace muchcool::xgdi
@@ -7,7 +7,16 @@
 #include "bitmap.hpp"
 #include "datatypes.hpp"
 #include "formatted_text.hpp"
+#include "frame_stats.hpp"
+#include "frame_trace.hpp"
+#include "layer.hpp"
 #include "muchcool/rndr.hpp"
+#include "offscreen_target.hpp"
+#include "path.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <variant>
 
 namespace muchcool::xgdi {
 
@@ -35,8 +44,124 @@ struct _GlyphInfo {
   glm::vec4 Color;
 };
 
+struct _PathVertex {
+  // z is the negated depth, like the z of model matrices.
+  glm::vec3 Position;
+  glm::vec4 Color;
+};
+
+class RenderImage;
+
 using DrawCustomCallback = void (*)(vk::CommandBuffer& commandBuffer);
 
+// Everything needed to record a draw, kept by value while occlusion culling
+// defers recording.
+struct _RectangleDraw {
+  _RectangleInfo Info;
+};
+
+struct _RoundRectDraw {
+  _RoundRectInfo Info;
+  bool Stroked;
+};
+
+struct _GlyphDraw {
+  _GlyphInfo Info;
+  Shared<Glyph> Source;
+};
+
+struct _BitmapDraw {
+  _RectangleInfo Info;
+  Shared<rndr::Texture> Texture;
+};
+
+struct _LayerDraw {
+  _RectangleInfo Info;
+  Shared<RenderImage> Image;
+};
+
+struct _TrianglesDraw {
+  vk::Buffer Buffer;
+  vk::DeviceSize Offset;
+  uint32 Count;
+};
+
+struct _CustomDraw {
+  DrawCustomCallback Callback;
+};
+
+using _DrawRecord =
+    std::variant<_RectangleDraw, _RoundRectDraw, _GlyphDraw, _BitmapDraw,
+                 _LayerDraw, _TrianglesDraw, _CustomDraw>;
+
+struct _DeferredDraw {
+  Rect Bounds;
+  Rect Occluder;
+  _DrawRecord Record;
+  bool Culled = false;
+};
+
+class Pipeline;
+
+struct _PipelineSet {
+  Shared<Pipeline> Rectangle;
+  Shared<Pipeline> RoundRect;
+  Shared<Pipeline> RoundRectFill;
+  Shared<Pipeline> Glyph;
+  Shared<Pipeline> Bitmap;
+  Shared<Pipeline> Path;
+  // Composites the premultiplied contents of a layer.
+  Shared<Pipeline> Layer;
+  // Test and write depth, draws are assigned depths by next_depth.
+  bool DepthTested = false;
+};
+
+class HostBuffer;
+class Presenter;
+
+// Command buffers of one frame and the resources they reference, kept alive
+// until the GPU finished the frame.
+struct _FrameResources {
+  std::vector<vk::CommandBuffer> CommandBuffers;
+  Shared<rndr::CommandBuffer> ImageTransitionCommands;
+
+  std::vector<Shared<rndr::UniformBuffer<_RectangleInfo>>> RectUniforms;
+  std::vector<Shared<rndr::UniformBuffer<_RoundRectInfo>>> RoundRectUniforms;
+  std::vector<Shared<rndr::UniformBuffer<_GlyphInfo>>> GlyphUniforms;
+  std::vector<Shared<rndr::UniformBuffer<_RenderInfo>>> LayerRenderInfoUniforms;
+
+  std::vector<Shared<HostBuffer>> PathVertexBuffers;
+  size_t PathVertexChunk = 0;
+  vk::DeviceSize PathVertexOffset = 0;
+
+  std::vector<Shared<rndr::DescriptorPool>> OverflowDescriptorPools;
+  std::vector<Shared<rndr::DescriptorSet>> TransformDescriptorSets;
+  std::vector<Shared<rndr::DescriptorSet>> GlyphDescriptorSets;
+
+  // Layer images sampled by the frame, a layer may be re-rendered, evicted
+  // or destroyed while the frame is in flight.
+  std::vector<Shared<RenderImage>> LayerImages;
+  // Glyphs sampled by the frame, kept out of font cache eviction.
+  std::vector<Shared<Glyph>> Glyphs;
+  // Bitmap textures sampled by the frame.
+  std::vector<Shared<rndr::Texture>> Textures;
+
+  // Start and end timestamp queries of the frame in the query pool.
+  uint32 FirstTimestamp = 0;
+};
+
+enum class SubmitMode {
+  // submit acquires, submits and presents on the calling thread and waits
+  // for the GPU.
+  Synchronous,
+  // A presenter thread presents every submitted frame in order. submit only
+  // blocks while all frame slots are in flight.
+  Queued,
+  // A presenter thread presents the latest submitted frame, frames it did
+  // not get to are dropped. submit never blocks.
+  Mailbox
+};
+
 class DrawingContext : public virtual Object {
   using RenderUniformBuffer = rndr::UniformBuffer<_RenderInfo>;
   using RectUniformBuffer = rndr::UniformBuffer<_RectangleInfo>;
@@ -44,6 +169,8 @@ class DrawingContext : public virtual Object {
   using GlyphUniformBuffer = rndr::UniformBuffer<_GlyphInfo>;
 
   Shared<rndr::RenderSurface> _renderSurface;
+  Shared<OffscreenTarget> _offscreenTarget;
+  Shared<rndr::GraphicsContext> _context;
 
   Shared<rndr::DescriptorSetLayout> _renderInfoSetLayout;
   Shared<rndr::DescriptorSetLayout> _modelInfoSetLayout;
@@ -51,33 +178,69 @@ class DrawingContext : public virtual Object {
   Shared<rndr::PipelineLayout> _pipelineLayout;
   Shared<rndr::PipelineLayout> _sampledPipelineLayout;
 
-  Shared<rndr::GraphicsPipeline> _rectanglePipeline;
-  Shared<rndr::GraphicsPipeline> _roundRectPipeline;
-  Shared<rndr::GraphicsPipeline> _glyphPipeline;
-  Shared<rndr::GraphicsPipeline> _bitmapPipeline;
+  _PipelineSet _surfacePipelines;
+  _PipelineSet* _pipelines;
 
   Shared<rndr::CommandPool> _commandPool;
-  std::vector<vk::CommandBuffer> _commandBuffers;
-  Shared<rndr::CommandBuffer> _imageTransitionCommands;
+  size_t _framebufferCount = 0;
+  std::vector<Shared<_FrameResources>> _frames;
+  _FrameResources* _frameResources = nullptr;
+  uint32 _frameSlot = 0;
+  std::vector<vk::CommandBuffer>* _recordingBuffers;
+
+  Shared<rndr::RenderPass> _layerRenderPass;
+  _PipelineSet _layerPipelines;
+  std::vector<vk::CommandBuffer> _layerCommandBuffers;
+  vk::Fence _layerFence;
+  vk::Sampler _layerSampler;
+  Layer* _recordingLayer = nullptr;
+
+  std::list<Layer*> _layers;
+  vk::DeviceSize _layerMemory = 0;
+  vk::DeviceSize _layerBudget = 256 * 1024 * 1024;
+  uint64 _frame = 0;
 
   _RenderInfo _renderInfo;
   Shared<RenderUniformBuffer> _renderInfoUniformBuffer;
 
-  std::vector<Shared<RectUniformBuffer>> _rectUniforms;
-  std::vector<Shared<RoundRectUniformBuffer>> _roundRectUniforms;
-  std::vector<Shared<GlyphUniformBuffer>> _glyphUniforms;
+  std::vector<Point> _tessellation;
+
+  bool _occlusionCulling = false;
+  std::vector<_DeferredDraw> _deferredDraws;
+  uint32 _depthCount = 0;
+
+  FrameStats _frameStats;
+  mutable FrameStats _lastFrameStats;
+  FrameStats _counterBaseline;
+  std::chrono::steady_clock::time_point _recordingStart;
+  vk::Pipeline _boundPipeline;
+
+  vk::QueryPool _timestampPool;
+  float _timestampPeriod = 1.0f;
+  // Queues without valid timestamp bits get no queries, GpuMs stays 0.
+  bool _timestampsSupported = false;
+  // Written by whichever thread waited for the frame's fence.
+  mutable std::atomic<double> _gpuMs = 0.0;
+  // Offscreen frames are not waited for on submit, their timestamps are read
+  // later on the recording thread.
+  mutable bool _timestampsPending = false;
+
+  Shared<FrameTrace> _pendingCapture;
+  Shared<FrameTrace> _capture;
 
   Shared<rndr::DescriptorPool> _descriptorPool;
   Shared<rndr::DescriptorSet> _renderDescriptor;
 
-  std::vector<Shared<rndr::DescriptorSet>> _transformDescriptorSets;
-  std::vector<Shared<rndr::DescriptorSet>> _glyphDescriptorSets;
-
   vk::Semaphore _imageAvailableSemaphore;
   vk::Semaphore _renderFinishedSemaphore;
 
+  Shared<Presenter> _presenter;
+
  public:
   DrawingContext(Shared<rndr::RenderSurface> surface_);
+  // Headless context, frames are rendered into the target and can be read
+  // back with OffscreenTarget::read_pixels after submit.
+  DrawingContext(Shared<OffscreenTarget> target_);
   DrawingContext(DrawingContext&&) = delete;
   DrawingContext(const DrawingContext&) = delete;
   ~DrawingContext() override;
@@ -87,7 +250,33 @@ class DrawingContext : public virtual Object {
   void start_recording();
   void end_recording();
 
-  void submit() const;
+  void submit();
+
+  // Selects whether frames are presented on the calling thread or on a
+  // presenter thread. Only render surfaces support presenter threads. Call
+  // between frames, before reset.
+  void set_submit_mode(SubmitMode mode);
+
+  // Defers recording until end_recording and skips primitives completely
+  // hidden behind opaque rectangles or bitmaps drawn after them. Offscreen
+  // targets and layers have a depth attachment: there, opaque rectangles and
+  // bitmaps are drawn first, front to back, and the depth test rejects the
+  // parts of other primitives they hide. Render surfaces have none, partially
+  // hidden primitives are drawn in full there.
+  void set_occlusion_culling(bool enabled);
+
+  // Statistics of the last recorded frame. GpuMs is updated once the GPU has
+  // finished a submitted frame and otherwise lags behind. It stays 0 on
+  // queues without timestamp support.
+  const FrameStats& frame_stats() const;
+
+  // Draws frame_stats as a text overlay at the given point.
+  void draw_frame_stats(const Point& point, const Shared<Font>& font);
+
+  // Records the draws of the next frame, from start_recording to
+  // end_recording, into the trace. Custom draws, layer contents and
+  // draw_layer are not captured.
+  void capture_frame(Shared<FrameTrace> trace);
 
   void draw_rectangle(const Rect& rect, const Color& color);
 
@@ -97,6 +286,18 @@ class DrawingContext : public virtual Object {
   void draw_rectangle(const Rect& rect, const Size& radius, const Color& fill,
                       const Color& stroke = {}, float strokeThickness = 0);
 
+  // Strokes the polyline with a single draw call. The stroke triangles
+  // overlap at joins and self intersections. Offscreen targets and layers
+  // cover each pixel once, on render surfaces translucent strokes blend twice
+  // where they overlap.
+  void draw_polyline(ArrayProxy<const Point> points, const Color& color,
+                     const StrokeStyle& style = {});
+
+  // Fills and strokes the path with a single draw call. Overlapping stroke
+  // triangles blend like draw_polyline.
+  void draw_path(const Path& path, const Color& fill, const Color& stroke = {},
+                 const StrokeStyle& style = {});
+
   void draw_formatted_text(const Point& point, const FormattedText& text,
                            const Color& color = Color::Black);
 
@@ -104,9 +305,72 @@ class DrawingContext : public virtual Object {
 
   void draw_custom(DrawCustomCallback callback);
 
+  Shared<Layer> create_layer(uint32 width, uint32 height);
+
+  // Least recently used layers are released once the memory held by all
+  // layers exceeds the budget. Layers drawn this frame are never released.
+  void set_layer_budget(vk::DeviceSize bytes);
+
+  // Redirects following draws into the layer until end_layer. Returns false,
+  // without redirecting, if the layer still holds valid contents.
+  bool begin_layer(Layer& layer);
+  void end_layer();
+
+  void draw_layer(const Rect& rect, Layer& layer);
+
  private:
-  void draw_rectangle(const _RoundRectInfo& roundRectInfo);
-  void draw_glyph(const Point& point, const Glyph& glyph, const Color& color);
+  friend class Layer;
+
+  void initialize(const Shared<rndr::RenderPass>& renderPass,
+                  size_t framebufferCount, const vk::Viewport& viewport,
+                  bool depthTested);
+
+  Shared<rndr::DescriptorSet> allocate_descriptor_set(
+      const rndr::DescriptorSetLayout& layout);
+
+  // Serializes queue access with the presenter thread: submits, presents and
+  // texture uploads.
+  template <typename Function>
+  void with_render_lock(Function&& function) const;
+  void submit_offscreen() const;
+  void present_frame(const _FrameResources& frame) const;
+  // Publishes the GPU time of the frame if its timestamps are available.
+  bool read_gpu_time(const _FrameResources& frame) const;
+
+  Shared<_FrameResources> create_frame_resources() const;
+  void select_frame(uint32 slot);
+
+  // Binds the pipeline on all recording command buffers unless it is already
+  // bound.
+  void bind_pipeline(const Pipeline& pipeline);
+
+  // The trace draws are captured into, null while recording into a layer.
+  FrameTrace* capturing() const;
+
+  void create_layer_resources();
+  void touch_layer(Layer& layer);
+  void evict_layers();
+
+  // Depth of the next draw on depth tested targets, nearer than all draws
+  // before it.
+  float next_depth();
+
+  void enqueue_draw(const Rect& bounds, const Rect& occluder,
+                    _DrawRecord&& record);
+  void flush_deferred_draws();
+
+  void record_draw(const _RectangleDraw& draw);
+  void record_draw(const _RoundRectDraw& draw);
+  void record_draw(const _GlyphDraw& draw);
+  void record_draw(const _BitmapDraw& draw);
+  void record_draw(const _LayerDraw& draw);
+  void record_draw(const _TrianglesDraw& draw);
+  void record_draw(const _CustomDraw& draw);
+
+  void draw_glyph(const Point& point, const Shared<Glyph>& glyph,
+                  const Color& color);
+  void draw_triangles(size_t fillCount, const Color& fill,
+                      const Color& stroke);
 };
 
 }  // namespace muchcool::xgdi
\ No newline at end of file
@@ -7,14 +7,28 @@
 
 #include <muchcool/rndr.hpp>
 
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
 #include <unordered_map>
 
 namespace muchcool::xgdi {
 
 using CharCode = ft::CharCode;
 
+class Font;
+class MappedFile;
+
 class Glyph : public rndr::GraphicsObject {
+  friend class Font;
+
+  // Cache epoch of the last lookup, eviction releases the oldest first.
+  std::atomic<uint64> _lastUse = 0;
+
   Shared<rndr::Texture> _texture;
+  std::once_flag _textureOnce;
+  std::atomic<bool> _hasTexture = false;
+  std::vector<uint8> _bitmap;
 
   FT_Glyph_Metrics _metrics;
 
@@ -29,13 +43,26 @@ class Glyph : public rndr::GraphicsObject {
   Glyph(Glyph&&) = delete;
   Glyph(const Glyph&) = delete;
 
+  // Null until create_texture has been called.
   auto& texture() const { return _texture; }
+  bool has_texture() const {
+    return _hasTexture.load(std::memory_order_acquire);
+  }
+  // Uploads the bitmap once, safe to call from multiple threads. Callers
+  // serialize it with other submits to the context's queue.
+  void create_texture();
+  // Signed distance field of the glyph, bitmap_size texels, row major.
+  auto& bitmap() const { return _bitmap; }
 
   auto& size() const { return _size; }
   auto& bearing() const { return _bearing; }
   auto& bitmap_size() const { return _bitmap_size; }
   auto& bitmap_baseline() const { return _bitmap_baseline; }
   auto advance() const { return _advance; }
+
+  // Bytes held by the bitmap and its texture, counted before the texture
+  // is created.
+  size_t memory_size() const;
 };
 
 class Font : public rndr::GraphicsObject {
@@ -50,15 +77,24 @@ class Font : public rndr::GraphicsObject {
 #endif
 
  private:
+  // Font file mapped once and shared by all sizes, must outlive the face.
+  Shared<MappedFile> _fontData;
   ft::Face _face;
 
   fs::path _font;
   float _size;
 
-  std::unordered_map<CharCode, Glyph> _characterCache;
+  // Guards the face, _characterCache and _kerningCache. Lookups of cached
+  // glyphs only take a shared lock and write no state shared with other
+  // fonts.
+  mutable std::shared_mutex _mutex;
+  std::unordered_map<CharCode, Shared<Glyph>> _characterCache;
+
+  bool _hasKerning;
+  std::unordered_map<uint64, float> _kerningCache;
 
-  Font(Shared<rndr::GraphicsContext> context, fs::path fontPath = SegoeUI,
-       float size = 12.0f);
+  Font(Shared<rndr::GraphicsContext> context, fs::path fontPath, float size,
+       Shared<MappedFile> fontData);
 
   Font(Font&&) = default;
   Font(const Font&) = delete;
@@ -66,10 +102,29 @@ class Font : public rndr::GraphicsObject {
  public:
   ~Font() override;
 
+  // Returns the cached font for the context, path and size, or loads it.
+  // Safe to call from multiple threads.
   static Shared<Font> Load(Shared<rndr::GraphicsContext> context,
                            fs::path fontPath = SegoeUI, float size = 12.0f);
 
-  const Glyph& glyph(CharCode code);
+  // Glyphs and kerning pairs of all fonts share one memory budget, 64 MB by
+  // default. Once it is exceeded, fonts only referenced by the font cache
+  // are released, then the least recently used glyphs along with the
+  // kerning pairs of their font, down to 7/8 of the budget. Glyphs still
+  // referenced, e.g. by frames in flight, are never released.
+  static void SetCacheBudget(size_t bytes);
+  static size_t GetCacheMemory();
+
+  // Drawing contexts hold on to the returned glyph until the frame using it
+  // has finished.
+  Shared<Glyph> glyph(CharCode code);
+
+  // Horizontal adjustment between two adjacent characters, cached per pair
+  // up to a fixed number of pairs per font.
+  float kerning(CharCode left, CharCode right);
+
+  auto& path() const { return _font; }
+  auto size() const { return _size; }
 
   auto line_height() const { return _face.metrics().height / 64.0f; }
 
@@ -78,6 +133,10 @@ class Font : public rndr::GraphicsObject {
   auto descender() const { return _face.metrics().descender / 64.0f; }
 
   // auto baseline_y() const { return _face.metrics().ascender / 64.0f; }
+
+ private:
+  void touch(Glyph& glyph);
+  static void EvictGlyphs();
 };
 
 }  // namespace muchcool::xgdi
\ No newline at end of file
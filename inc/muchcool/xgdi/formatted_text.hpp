@@ -3,19 +3,30 @@
 
 #pragma once
 
+#include "datatypes.hpp"
 #include "font.hpp"
 
 namespace muchcool::xgdi {
 
+// Visible glyph of a FormattedText, positioned relative to the text origin.
+struct _PositionedGlyph {
+  CharCode Code;
+  Point Offset;
+};
+
 class FormattedText final : public Object {
   Shared<Font> _font;
   std::string _text;
+  std::vector<_PositionedGlyph> _glyphs;
 
  public:
+  // Decodes the UTF-8 text and lays out its glyphs with kerning once, drawing
+  // reuses the positions.
   FormattedText(Shared<Font> font, const char* text);
 
   constexpr auto& font() const { return _font; }
   constexpr auto& text() const { return _text; }
+  constexpr auto& glyphs() const { return _glyphs; }
 };
 
 }  // namespace muchcool::xgdi
\ No newline at end of file
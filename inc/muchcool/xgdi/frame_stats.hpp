@@ -0,0 +1,42 @@
+// Copyright (c) 2023 Jacob R. Green
+// All Rights Reserved.
+
+#pragma once
+
+#include "datatypes.hpp"
+
+namespace muchcool::xgdi {
+
+struct FrameStats {
+  uint32 Draws = 0;
+  uint32 CulledDraws = 0;
+  uint32 PipelineBinds = 0;
+  uint32 DescriptorAllocations = 0;
+  uint64 UniformBytes = 0;
+  uint64 VertexBytes = 0;
+  uint64 GlyphCacheHits = 0;
+  uint64 GlyphCacheMisses = 0;
+  uint64 GlyphEvictions = 0;
+  uint64 TexturesCreated = 0;
+
+  // Time between start_recording and end_recording.
+  double CpuRecordingMs = 0.0;
+  // GPU time of the render pass of the most recently completed frame, 0 if
+  // the queue does not support timestamps.
+  double GpuMs = 0.0;
+};
+
+// Counters for resources shared between drawing contexts, kept per thread so
+// cache hits write no shared memory. DrawingContext reports how much the
+// counters of the recording thread changed over a frame.
+struct ResourceCounters {
+  uint64 GlyphCacheHits = 0;
+  uint64 GlyphCacheMisses = 0;
+  uint64 GlyphEvictions = 0;
+  uint64 TexturesCreated = 0;
+
+  // Counters of the calling thread.
+  static ResourceCounters& Get();
+};
+
+}  // namespace muchcool::xgdi
@@ -0,0 +1,94 @@
+// Copyright (c) 2023 Jacob R. Green
+// All Rights Reserved.
+
+#pragma once
+
+#include "bitmap.hpp"
+#include "datatypes.hpp"
+#include "formatted_text.hpp"
+#include "path.hpp"
+
+#include <unordered_map>
+
+namespace muchcool::xgdi {
+
+class CpuDrawingContext;
+class DrawingContext;
+
+enum class _TraceCommand : uint8 {
+  Rectangle,
+  RoundRect,
+  Polyline,
+  Path,
+  Text,
+  Bitmap
+};
+
+struct _TraceFont {
+  std::string Path;
+  float Size;
+};
+
+// Draw calls of a single frame in a compact binary form, captured with
+// DrawingContext::capture_frame. Fonts and bitmaps are referenced by file
+// path, a trace replays wherever the same files are available.
+class FrameTrace final : public Object {
+  uint32 _width = 0;
+  uint32 _height = 0;
+
+  std::vector<_TraceFont> _fonts;
+  std::vector<std::string> _bitmaps;
+  std::vector<uint8> _commands;
+  uint32 _commandCount = 0;
+
+  std::unordered_map<const Font*, uint32> _fontIndices;
+  std::unordered_map<const Bitmap*, uint32> _bitmapIndices;
+
+  std::vector<Shared<Font>> _loadedFonts;
+  std::vector<Shared<Bitmap>> _loadedBitmaps;
+
+ public:
+  FrameTrace() = default;
+  FrameTrace(FrameTrace&&) = delete;
+  FrameTrace(const FrameTrace&) = delete;
+
+  static Shared<FrameTrace> Load(const fs::path& path);
+  void save(const fs::path& path) const;
+
+  auto width() const { return _width; }
+  auto height() const { return _height; }
+  auto command_count() const { return _commandCount; }
+
+  // Discards all recorded commands and resources.
+  void clear(uint32 width, uint32 height);
+
+  void record_rectangle(const Rect& rect, const Color& color);
+  void record_rectangle(const Rect& rect, const Size& radius,
+                        const Color& fill, const Color& stroke,
+                        float strokeThickness);
+  void record_polyline(ArrayProxy<const Point> points, const Color& color,
+                       const StrokeStyle& style);
+  void record_path(const Path& path, const Color& fill, const Color& stroke,
+                   const StrokeStyle& style);
+  void record_formatted_text(const Point& point, const FormattedText& text,
+                             const Color& color);
+  void record_bitmap(const Rect& rect, const Bitmap& bitmap);
+
+  // Loads the referenced fonts and bitmaps, must be called before replay.
+  // Pass no context to replay on a CpuDrawingContext.
+  void load_resources(Shared<rndr::GraphicsContext> context);
+
+  // Issues the recorded draws between start_recording and end_recording of
+  // the caller. The trace must outlive end_recording.
+  void replay(DrawingContext& context) const;
+  void replay(CpuDrawingContext& context) const;
+
+ private:
+  uint32 font_index(const Shared<Font>& font);
+  uint32 bitmap_index(const Bitmap& bitmap);
+
+  template <typename Context>
+  void replay_commands(Context& context) const;
+};
+
+}  // namespace muchcool::xgdi
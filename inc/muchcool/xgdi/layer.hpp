@@ -0,0 +1,48 @@
+// Copyright (c) 2023 Jacob R. Green
+// All Rights Reserved.
+
+#pragma once
+
+#include "datatypes.hpp"
+
+#include <list>
+
+namespace muchcool::xgdi {
+
+class DrawingContext;
+class RenderImage;
+
+// Offscreen texture caching the rendered result of a group of draws. The
+// contents are kept until the layer is invalidated or evicted by its
+// DrawingContext to stay within the layer memory budget. Contents are held
+// with premultiplied alpha, so translucent edges composite unchanged.
+class Layer final : public Object {
+  friend class DrawingContext;
+
+  DrawingContext* _owner;
+  std::list<Layer*>::iterator _lruEntry;
+
+  uint32 _width;
+  uint32 _height;
+
+  Shared<RenderImage> _image;
+  bool _valid = false;
+  uint64 _lastUsedFrame = 0;
+
+  Layer(DrawingContext* owner, uint32 width, uint32 height);
+
+ public:
+  Layer(Layer&&) = delete;
+  Layer(const Layer&) = delete;
+  ~Layer() override;
+
+  auto width() const { return _width; }
+  auto height() const { return _height; }
+
+  // True while the cached contents can be drawn without re-rendering.
+  auto valid() const { return _valid; }
+
+  void invalidate() { _valid = false; }
+};
+
+}  // namespace muchcool::xgdi
@@ -0,0 +1,63 @@
+// Copyright (c) 2023 Jacob R. Green
+// All Rights Reserved.
+
+#pragma once
+
+#include "datatypes.hpp"
+
+#include <future>
+#include <mutex>
+
+namespace muchcool::xgdi {
+
+class HostBuffer;
+class RenderImage;
+
+// Render target backed by a plain image instead of a swapchain, for headless
+// rendering. Every submitted frame is copied into a host visible buffer that
+// can be read back with read_pixels.
+class OffscreenTarget final : public rndr::GraphicsObject {
+ public:
+  static constexpr auto Format = vk::Format::eR8G8B8A8Unorm;
+
+ private:
+  Shared<rndr::RenderPass> _renderPass;
+  Shared<RenderImage> _image;
+  Shared<HostBuffer> _readbackBuffer;
+  vk::Fence _fence;
+
+  mutable std::mutex _renderMutex;
+
+ public:
+  OffscreenTarget(Shared<rndr::GraphicsContext> context, uint32 width,
+                  uint32 height);
+  OffscreenTarget(OffscreenTarget&&) = delete;
+  OffscreenTarget(const OffscreenTarget&) = delete;
+  ~OffscreenTarget() override;
+
+  uint32 width() const;
+  uint32 height() const;
+  vk::Extent2D extent() const;
+
+  vk::Viewport viewport() const;
+  vk::Rect2D scissor() const;
+
+  auto& render_pass() const { return _renderPass; }
+  vk::Framebuffer framebuffer() const;
+
+  // Signaled once the last submitted frame finished, including its readback.
+  auto& fence() const { return _fence; }
+
+  auto LockRenderMutex() const { return std::unique_lock{_renderMutex}; }
+
+  // Records copying the rendered image into the readback buffer, called by
+  // DrawingContext after the render pass.
+  void record_readback(vk::CommandBuffer& commandBuffer) const;
+
+  // Copies the last submitted frame as tightly packed RGBA8 rows into
+  // `pixels` once the GPU is done with it. The target must not be submitted
+  // to again before the returned future is ready.
+  std::future<void> read_pixels(ArrayProxy<uint8> pixels) const;
+};
+
+}  // namespace muchcool::xgdi
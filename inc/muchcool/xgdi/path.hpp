@@ -0,0 +1,46 @@
+// Copyright (c) 2023 Jacob R. Green
+// All Rights Reserved.
+
+#pragma once
+
+#include "datatypes.hpp"
+
+#include <vector>
+
+namespace muchcool::xgdi {
+
+enum class LineJoin { Miter, Bevel, Round };
+
+enum class LineCap { Butt, Square, Round };
+
+struct StrokeStyle {
+  float Thickness = 1.0f;
+  LineJoin Join = LineJoin::Miter;
+  LineCap Cap = LineCap::Butt;
+  float MiterLimit = 4.0f;
+};
+
+struct SubPath {
+  uint32 First;
+  uint32 Count;
+  bool Closed;
+};
+
+// A sequence of straight line contours. Fills are triangulated as fans, so
+// filled contours are expected to be convex.
+class Path final {
+  std::vector<Point> _points;
+  std::vector<SubPath> _subPaths;
+
+ public:
+  Path& move_to(const Point& point);
+  Path& line_to(const Point& point);
+  Path& close();
+
+  void clear();
+
+  auto& points() const { return _points; }
+  auto& sub_paths() const { return _subPaths; }
+};
+
+}  // namespace muchcool::xgdi
@@ -3,6 +3,7 @@
 // All Rights Reserved.
 
 #include "muchcool/xgdi/bitmap.hpp"
+#include "muchcool/xgdi/frame_stats.hpp"
 
 #include "IL/il.h"
 #include "IL/ilu.h"
@@ -12,7 +13,7 @@ namespace muchcool::xgdi {
 bool ilInitialized = false;
 
 Bitmap::Bitmap(Shared<rndr::GraphicsContext> context_, const char* filePath)
-    : GraphicsObject(std::move(context_)) {
+    : GraphicsObject(std::move(context_)), _path(filePath) {
   if (!ilInitialized) {
     ilInit();
     iluInit();
@@ -38,15 +39,25 @@ Bitmap::Bitmap(Shared<rndr::GraphicsContext> context_, const char* filePath)
   _width = info.Width;
   _height = info.Height;
 
-  auto pixelData = std::vector<uint32>(_width * _height);
+  _pixels = std::vector<uint32>(_width * _height);
   auto copyResult = ilCopyPixels(0, 0, 0, _width, _height, 1, IL_RGBA,
-                                 IL_UNSIGNED_BYTE, pixelData.data());
+                                 IL_UNSIGNED_BYTE, _pixels.data());
 
-  _texture = Shared{
-      new rndr::Texture(context(), _width, _height, vk::Format::eR8G8B8A8Unorm,
-                        sizeof(uint32) * _width * _height, ilGetData())};
+  _opaque = std::all_of(_pixels.begin(), _pixels.end(), [](uint32 pixel) {
+    return (pixel >> 24) == 0xFF;
+  });
 
   ilDeleteImages(1, &image);
 }
 
+void Bitmap::CreateTexture() const {
+  std::call_once(_textureOnce, [this] {
+    _texture = Shared{new rndr::Texture(
+        context(), _width, _height, vk::Format::eR8G8B8A8Unorm,
+        sizeof(uint32) * _width * _height, _pixels.data())};
+    ++ResourceCounters::Get().TexturesCreated;
+    _hasTexture.store(true, std::memory_order_release);
+  });
+}
+
 }  // namespace muchcool::xgdi
\ No newline at end of file
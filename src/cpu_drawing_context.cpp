@@ -0,0 +1,548 @@
+// Copyright (c) 2023 Jacob R. Green
+// All Rights Reserved.
+
+#include "muchcool/xgdi/cpu_drawing_context.hpp"
+
+#include "tessellator.hpp"
+
+#include <array>
+#include <atomic>
+#include <limits>
+
+#define CPU_TILE_SIZE 64
+
+namespace muchcool::xgdi {
+
+static uint32 to_byte(float x) {
+  return static_cast<uint32>(std::clamp(x, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+static float from_byte(uint32 x) { return (x & 0xFF) / 255.0f; }
+
+static uint32 pack(const Color& color) {
+  return to_byte(color.r) | to_byte(color.g) << 8 | to_byte(color.b) << 16 |
+         to_byte(color.a) << 24;
+}
+
+static Color unpack(uint32 pixel) {
+  return {from_byte(pixel), from_byte(pixel >> 8), from_byte(pixel >> 16),
+          from_byte(pixel >> 24)};
+}
+
+// (x + 127) / 255 without a division.
+static uint32 div255(uint32 x) {
+  x += 128;
+  return (x + (x >> 8)) >> 8;
+}
+
+// Source over blending of a constant color into a span. Kept free of
+// branches and float conversions so the loop vectorizes.
+static void blend_span(uint32* __restrict span, uint32 count,
+                       const Color& color) {
+  const auto packed = pack(color);
+  const auto alpha = packed >> 24;
+
+  if (alpha == 0xFF) {
+    std::fill_n(span, count, packed);
+    return;
+  }
+
+  const auto inverse = 0xFF - alpha;
+  const auto r = (packed & 0xFF) * alpha;
+  const auto g = (packed >> 8 & 0xFF) * alpha;
+  const auto b = (packed >> 16 & 0xFF) * alpha;
+  const auto a = alpha * 0xFF;
+
+  for (uint32 i = 0; i < count; ++i) {
+    const auto dst = span[i];
+    span[i] = div255(r + (dst & 0xFF) * inverse) |
+              div255(g + (dst >> 8 & 0xFF) * inverse) << 8 |
+              div255(b + (dst >> 16 & 0xFF) * inverse) << 16 |
+              div255(a + (dst >> 24 & 0xFF) * inverse) << 24;
+  }
+}
+
+// Source over blending of a constant color, scaled by per pixel coverage,
+// into a span.
+static void blend_span(uint32* __restrict span, uint32 count,
+                       const Color& color, const uint8* __restrict coverage) {
+  const auto packed = pack(color);
+  const auto alpha = packed >> 24;
+  const auto r = packed & 0xFF;
+  const auto g = packed >> 8 & 0xFF;
+  const auto b = packed >> 16 & 0xFF;
+
+  for (uint32 i = 0; i < count; ++i) {
+    const auto dst = span[i];
+    const auto a = div255(alpha * coverage[i]);
+    const auto inverse = 0xFF - a;
+    span[i] = div255(r * a + (dst & 0xFF) * inverse) |
+              div255(g * a + (dst >> 8 & 0xFF) * inverse) << 8 |
+              div255(b * a + (dst >> 16 & 0xFF) * inverse) << 16 |
+              div255(a * 0xFF + (dst >> 24 & 0xFF) * inverse) << 24;
+  }
+}
+
+// Source over blending of packed straight alpha pixels into a span.
+static void blend_span(uint32* __restrict span, uint32 count,
+                       const uint32* __restrict source) {
+  for (uint32 i = 0; i < count; ++i) {
+    const auto src = source[i];
+    const auto dst = span[i];
+    const auto a = src >> 24;
+    const auto inverse = 0xFF - a;
+    span[i] = div255((src & 0xFF) * a + (dst & 0xFF) * inverse) |
+              div255((src >> 8 & 0xFF) * a + (dst >> 8 & 0xFF) * inverse)
+                  << 8 |
+              div255((src >> 16 & 0xFF) * a + (dst >> 16 & 0xFF) * inverse)
+                  << 16 |
+              div255(a * 0xFF + (dst >> 24 & 0xFF) * inverse) << 24;
+  }
+}
+
+static float smoothstep(float edge0, float edge1, float x) {
+  if (edge1 <= edge0) return x < edge0 ? 0.0f : 1.0f;
+  const auto t = std::clamp((x - edge0) / (edge1 - edge0), 0.0f, 1.0f);
+  return t * t * (3.0f - 2.0f * t);
+}
+
+// Same distance function as roundrect.frag.
+static float sdf_rounded_rectangle(const Point& pos, const Size& size,
+                                   float radius) {
+  auto q = glm::max(glm::abs(pos) - size + radius, glm::vec2(0.0f));
+  return glm::length(q) - radius;
+}
+
+// Bilinear sample of an 8 bit texture with clamp to border addressing.
+static float sample_r8(const std::vector<uint8>& texels, uint32 width,
+                       uint32 height, const Point& uv) {
+  const auto x = uv.x * width - 0.5f;
+  const auto y = uv.y * height - 0.5f;
+  const auto x0 = static_cast<int>(std::floor(x));
+  const auto y0 = static_cast<int>(std::floor(y));
+  const auto fx = x - x0;
+  const auto fy = y - y0;
+
+  auto texel = [&](int tx, int ty) -> float {
+    if (tx < 0 || ty < 0 || tx >= (int)width || ty >= (int)height) return 0;
+    return texels[ty * width + tx] / 255.0f;
+  };
+
+  const auto top = texel(x0, y0) * (1 - fx) + texel(x0 + 1, y0) * fx;
+  const auto bottom = texel(x0, y0 + 1) * (1 - fx) + texel(x0 + 1, y0 + 1) * fx;
+  return top * (1 - fy) + bottom * fy;
+}
+
+// Bilinear sample of an RGBA8 texture with clamp to edge addressing.
+static Color sample_rgba8(const std::vector<uint32>& texels, uint32 width,
+                          uint32 height, const Point& uv) {
+  const auto x = std::clamp(uv.x * width - 0.5f, 0.0f, width - 1.0f);
+  const auto y = std::clamp(uv.y * height - 0.5f, 0.0f, height - 1.0f);
+  const auto x0 = static_cast<uint32>(x);
+  const auto y0 = static_cast<uint32>(y);
+  const auto x1 = std::min(x0 + 1, width - 1);
+  const auto y1 = std::min(y0 + 1, height - 1);
+  const auto fx = x - x0;
+  const auto fy = y - y0;
+
+  const auto a = unpack(texels[y0 * width + x0]);
+  const auto b = unpack(texels[y0 * width + x1]);
+  const auto c = unpack(texels[y1 * width + x0]);
+  const auto d = unpack(texels[y1 * width + x1]);
+
+  auto lerp = [](const Color& l, const Color& r, float t) -> Color {
+    return {l.r + (r.r - l.r) * t, l.g + (r.g - l.g) * t,
+            l.b + (r.b - l.b) * t, l.a + (r.a - l.a) * t};
+  };
+
+  return lerp(lerp(a, b, fx), lerp(c, d, fx), fy);
+}
+
+struct PixelBounds {
+  uint32 Left;
+  uint32 Top;
+  uint32 Right;
+  uint32 Bottom;
+};
+
+// Pixels whose center lies inside the rect, like the GPU rasterizer, clipped
+// to [x0, x1) x [y0, y1).
+static PixelBounds pixel_bounds(const Rect& rect, uint32 x0, uint32 y0,
+                                uint32 x1, uint32 y1) {
+  auto clamp = [](float value, uint32 min, uint32 max) {
+    return static_cast<uint32>(std::clamp<float>(value, min, max));
+  };
+
+  return PixelBounds{
+      .Left = clamp(std::ceil(rect.Offset.x - 0.5f), x0, x1),
+      .Top = clamp(std::ceil(rect.Offset.y - 0.5f), y0, y1),
+      .Right = clamp(std::ceil(rect.Offset.x + rect.Size.x - 0.5f), x0, x1),
+      .Bottom = clamp(std::ceil(rect.Offset.y + rect.Size.y - 0.5f), y0, y1)};
+}
+
+// Marks the pixels of `clip` whose center lies inside the triangle in `mask`,
+// which holds one row of (Right - Left) bytes per row of `clip`.
+static void cover_triangle(uint8* mask, const Point* v,
+                           const PixelBounds& clip) {
+  const auto min = glm::min(glm::min(v[0], v[1]), v[2]);
+  const auto max = glm::max(glm::max(v[0], v[1]), v[2]);
+  const auto bounds = pixel_bounds(Rect{min, max - min}, clip.Left, clip.Top,
+                                   clip.Right, clip.Bottom);
+  const auto stride = clip.Right - clip.Left;
+
+  for (auto y = bounds.Top; y < bounds.Bottom; ++y) {
+    const auto center = y + 0.5f;
+
+    auto left = std::numeric_limits<float>::max();
+    auto right = std::numeric_limits<float>::lowest();
+
+    for (int i = 0; i < 3; ++i) {
+      const auto& a = v[i];
+      const auto& b = v[(i + 1) % 3];
+      if ((a.y <= center) == (b.y <= center)) continue;
+
+      const auto x = a.x + (center - a.y) * (b.x - a.x) / (b.y - a.y);
+      left = std::min(left, x);
+      right = std::max(right, x);
+    }
+
+    const auto xs = static_cast<uint32>(std::clamp<float>(
+        std::ceil(left - 0.5f), bounds.Left, bounds.Right));
+    const auto xe = static_cast<uint32>(std::clamp<float>(
+        std::ceil(right - 0.5f), bounds.Left, bounds.Right));
+
+    auto* row = &mask[(y - clip.Top) * stride];
+    if (xs < xe) std::fill(row + xs - clip.Left, row + xe - clip.Left, 0xFF);
+  }
+}
+
+CpuDrawingContext::CpuDrawingContext(uint32 width, uint32 height,
+                                     uint32 threadCount)
+    : _width(width),
+      _height(height),
+      _threadCount(std::max(threadCount, 1u)),
+      _pixels(width * height) {}
+
+void CpuDrawingContext::reset() {
+  _commands.clear();
+  _vertices.clear();
+  _glyphs.clear();
+}
+
+void CpuDrawingContext::start_recording() {
+  _commands.clear();
+  _vertices.clear();
+  _glyphs.clear();
+}
+
+void CpuDrawingContext::end_recording() {
+  const auto tilesX = (_width + CPU_TILE_SIZE - 1) / CPU_TILE_SIZE;
+  const auto tilesY = (_height + CPU_TILE_SIZE - 1) / CPU_TILE_SIZE;
+  const auto tileCount = tilesX * tilesY;
+
+  bin_commands(tilesX, tilesY);
+
+  auto nextTile = std::atomic<uint32>{0};
+
+  auto worker = [&] {
+    for (auto tile = nextTile++; tile < tileCount; tile = nextTile++) {
+      const auto x0 = (tile % tilesX) * CPU_TILE_SIZE;
+      const auto y0 = (tile / tilesX) * CPU_TILE_SIZE;
+      rasterize_tile(tile, x0, y0, std::min(x0 + CPU_TILE_SIZE, _width),
+                     std::min(y0 + CPU_TILE_SIZE, _height));
+    }
+  };
+
+  auto threads = std::vector<std::thread>{};
+  for (uint32 i = 1; i < std::min(_threadCount, tileCount); ++i) {
+    threads.emplace_back(worker);
+  }
+
+  worker();
+  for (auto& thread : threads) thread.join();
+}
+
+void CpuDrawingContext::draw_rectangle(const Rect& rect, const Color& color) {
+  _commands.emplace_back(_CpuDrawCommand{.Type = _CpuDrawType::Rectangle,
+                                         .Bounds = rect,
+                                         .Fill = color});
+}
+
+void CpuDrawingContext::draw_line(const Point& start, const Point& end,
+                                  const Color& color, float thickness) {
+  auto width = glm::length(end - start);
+  draw_rectangle(Rect{start, {width, thickness}}, color);
+}
+
+void CpuDrawingContext::draw_rectangle(const Rect& rect, const Size& radius,
+                                       const Color& fill, const Color& stroke,
+                                       float strokeThickness) {
+  if (strokeThickness <= 0.0f && radius.x <= 0.0f) {
+    draw_rectangle(rect, fill);
+    return;
+  }
+
+  _commands.emplace_back(
+      _CpuDrawCommand{.Type = _CpuDrawType::RoundRect,
+                      .Bounds = rect,
+                      .Fill = fill,
+                      .Stroke = stroke,
+                      .Radius = radius,
+                      .StrokeThickness = std::max(strokeThickness, 0.0f)});
+}
+
+void CpuDrawingContext::draw_polyline(ArrayProxy<const Point> points,
+                                      const Color& color,
+                                      const StrokeStyle& style) {
+  const auto first = _vertices.size();
+  tessellate_stroke(points, false, style, _vertices);
+  draw_triangles(first, color);
+}
+
+void CpuDrawingContext::draw_path(const Path& path, const Color& fill,
+                                  const Color& stroke,
+                                  const StrokeStyle& style) {
+  auto& points = path.points();
+
+  if (fill.a > 0.0f) {
+    const auto first = _vertices.size();
+    for (auto& subPath : path.sub_paths()) {
+      tessellate_fill({subPath.Count, points.data() + subPath.First},
+                      _vertices);
+    }
+    draw_triangles(first, fill);
+  }
+
+  if (stroke.a > 0.0f) {
+    const auto first = _vertices.size();
+    for (auto& subPath : path.sub_paths()) {
+      tessellate_stroke({subPath.Count, points.data() + subPath.First},
+                        subPath.Closed, style, _vertices);
+    }
+    draw_triangles(first, stroke);
+  }
+}
+
+void CpuDrawingContext::draw_triangles(size_t first, const Color& color) {
+  if (first == _vertices.size()) return;
+
+  auto min = _vertices[first];
+  auto max = _vertices[first];
+  for (auto i = first; i < _vertices.size(); ++i) {
+    min = glm::min(min, _vertices[i]);
+    max = glm::max(max, _vertices[i]);
+  }
+
+  _commands.emplace_back(_CpuDrawCommand{
+      .Type = _CpuDrawType::Triangles,
+      .Bounds = Rect{min, max - min},
+      .Fill = color,
+      .FirstVertex = static_cast<uint32>(first),
+      .VertexCount = static_cast<uint32>(_vertices.size() - first)});
+}
+
+void CpuDrawingContext::draw_formatted_text(const Point& point,
+                                            const FormattedText& text,
+                                            const Color& color) {
+  auto& font = text.font();
+
+  auto origin = glm::round(point);
+
+  for (auto& positioned : text.glyphs()) {
+    auto& glyph = _glyphs.emplace_back(font->glyph(positioned.Code));
+
+    // Same placement as DrawingContext::draw_glyph.
+    auto offset = glyph->bitmap_baseline() * glm::vec2{1.0f, -1.0f};
+    _commands.emplace_back(_CpuDrawCommand{
+        .Type = _CpuDrawType::Glyph,
+        .Bounds = Rect{origin + positioned.Offset + offset,
+                       glyph->bitmap_size()},
+        .Fill = color,
+        .GlyphSource = glyph.get()});
+  }
+}
+
+void CpuDrawingContext::draw_bitmap(const Rect& rect, const Bitmap& bitmap) {
+  _commands.emplace_back(_CpuDrawCommand{.Type = _CpuDrawType::Bitmap,
+                                         .Bounds = rect,
+                                         .Fill = Color::White,
+                                         .BitmapSource = &bitmap});
+}
+
+void CpuDrawingContext::bin_commands(uint32 tilesX, uint32 tilesY) {
+  const auto tileCount = tilesX * tilesY;
+
+  // Counts commands per tile in a first pass and fills the index lists in a
+  // second one, so each tile only walks the commands overlapping it.
+  _tileOffsets.assign(tileCount + 1, 0);
+
+  auto forEachTile = [&](const _CpuDrawCommand& command, auto&& function) {
+    auto bounds = pixel_bounds(command.Bounds, 0, 0, _width, _height);
+    if (bounds.Left >= bounds.Right || bounds.Top >= bounds.Bottom) return;
+
+    const auto tx0 = bounds.Left / CPU_TILE_SIZE;
+    const auto tx1 = (bounds.Right - 1) / CPU_TILE_SIZE;
+    const auto ty0 = bounds.Top / CPU_TILE_SIZE;
+    const auto ty1 = (bounds.Bottom - 1) / CPU_TILE_SIZE;
+
+    for (auto ty = ty0; ty <= ty1; ++ty) {
+      for (auto tx = tx0; tx <= tx1; ++tx) function(ty * tilesX + tx);
+    }
+  };
+
+  for (auto& command : _commands) {
+    forEachTile(command, [&](uint32 tile) { ++_tileOffsets[tile + 1]; });
+  }
+
+  for (uint32 tile = 0; tile < tileCount; ++tile) {
+    _tileOffsets[tile + 1] += _tileOffsets[tile];
+  }
+
+  _tileCommands.resize(_tileOffsets.back());
+
+  // Filling from the back keeps draw order and leaves every offset at the
+  // start of its tile again.
+  for (auto index = static_cast<uint32>(_commands.size()); index-- > 0;) {
+    forEachTile(_commands[index], [&](uint32 tile) {
+      _tileCommands[--_tileOffsets[tile + 1]] = index;
+    });
+  }
+
+  std::copy(_tileOffsets.begin() + 1, _tileOffsets.end(),
+            _tileOffsets.begin());
+  _tileOffsets.back() = static_cast<uint32>(_tileCommands.size());
+}
+
+void CpuDrawingContext::rasterize_tile(uint32 tile, uint32 x0, uint32 y0,
+                                       uint32 x1, uint32 y1) {
+  // Like the render pass, start from transparent black.
+  for (auto y = y0; y < y1; ++y) {
+    std::fill_n(&_pixels[y * _width + x0], x1 - x0, 0u);
+  }
+
+  // Per pixel coverage and colors of one row of the tile.
+  std::array<uint8, CPU_TILE_SIZE> coverage;
+  std::array<uint8, CPU_TILE_SIZE> strokeCoverage;
+  std::array<uint32, CPU_TILE_SIZE> colors;
+  // Coverage of the whole tile, for triangle lists.
+  std::array<uint8, CPU_TILE_SIZE * CPU_TILE_SIZE> mask;
+
+  for (auto i = _tileOffsets[tile]; i < _tileOffsets[tile + 1]; ++i) {
+    const auto& command = _commands[_tileCommands[i]];
+    const auto& rect = command.Bounds;
+
+    const auto bounds = pixel_bounds(rect, x0, y0, x1, y1);
+    if (bounds.Left >= bounds.Right || bounds.Top >= bounds.Bottom) continue;
+
+    const auto xs = bounds.Left;
+    const auto xe = bounds.Right;
+    const auto ys = bounds.Top;
+    const auto ye = bounds.Bottom;
+    const auto count = xe - xs;
+
+    switch (command.Type) {
+      case _CpuDrawType::Rectangle:
+        for (auto y = ys; y < ye; ++y) {
+          blend_span(&_pixels[y * _width + xs], count, command.Fill);
+        }
+        break;
+
+      case _CpuDrawType::RoundRect: {
+        // Matches roundrect.frag and roundrect_fill.frag.
+        constexpr auto epsilon = 1e-37f;
+        const auto halfSize = rect.Size / 2.0f;
+        const auto thickness = command.StrokeThickness;
+
+        for (auto y = ys; y < ye; ++y) {
+          for (auto x = xs; x < xe; ++x) {
+            auto pos = Point{x + 0.5f, y + 0.5f} - rect.Offset - halfSize;
+
+            auto fillDistance = sdf_rounded_rectangle(
+                pos, halfSize - thickness, command.Radius.x);
+            auto fill = fillDistance < epsilon;
+            coverage[x - xs] = fill ? 0xFF : 0;
+
+            if (thickness > 0.0f) {
+              auto strokeDistance =
+                  sdf_rounded_rectangle(pos, halfSize, command.Radius.x);
+              auto stroke = strokeDistance < epsilon && !fill;
+              strokeCoverage[x - xs] = stroke ? 0xFF : 0;
+            }
+          }
+
+          auto span = &_pixels[y * _width + xs];
+          blend_span(span, count, command.Fill, coverage.data());
+          if (thickness > 0.0f) {
+            blend_span(span, count, command.Stroke, strokeCoverage.data());
+          }
+        }
+        break;
+      }
+
+      case _CpuDrawType::Glyph: {
+        // Matches glyph_sdf.frag, fwidth is taken from forward differences.
+        const auto& glyph = *command.GlyphSource;
+        const auto& texels = glyph.bitmap();
+        const auto texWidth = static_cast<uint32>(glyph.bitmap_size().x);
+        const auto texHeight = static_cast<uint32>(glyph.bitmap_size().y);
+        const auto texel = Size(1.0f) / rect.Size;
+
+        for (auto y = ys; y < ye; ++y) {
+          for (auto x = xs; x < xe; ++x) {
+            auto uv = (Point{x + 0.5f, y + 0.5f} - rect.Offset) / rect.Size;
+
+            auto d = sample_r8(texels, texWidth, texHeight, uv);
+            auto dx = sample_r8(texels, texWidth, texHeight,
+                                uv + Point{texel.x, 0.0f});
+            auto dy = sample_r8(texels, texWidth, texHeight,
+                                uv + Point{0.0f, texel.y});
+            auto aaf = (std::abs(dx - d) + std::abs(dy - d)) / 2;
+
+            coverage[x - xs] =
+                to_byte(smoothstep(0.5f - aaf, 0.5f + aaf, d));
+          }
+
+          blend_span(&_pixels[y * _width + xs], count, command.Fill,
+                     coverage.data());
+        }
+        break;
+      }
+
+      case _CpuDrawType::Bitmap: {
+        // Matches bitmap.frag.
+        const auto& bitmap = *command.BitmapSource;
+
+        for (auto y = ys; y < ye; ++y) {
+          for (auto x = xs; x < xe; ++x) {
+            auto uv = (Point{x + 0.5f, y + 0.5f} - rect.Offset) / rect.Size;
+            colors[x - xs] =
+                pack(sample_rgba8(bitmap.GetPixels(), bitmap.GetWidth(),
+                                  bitmap.GetHeight(), uv));
+          }
+
+          blend_span(&_pixels[y * _width + xs], count, colors.data());
+        }
+        break;
+      }
+
+      case _CpuDrawType::Triangles: {
+        // Each pixel blends once, even where the triangles overlap. Like the
+        // path pipeline on depth tested targets.
+        const auto* vertices = &_vertices[command.FirstVertex];
+        std::fill_n(mask.begin(), count * (ye - ys), uint8(0));
+
+        for (uint32 t = 0; t + 2 < command.VertexCount; t += 3) {
+          cover_triangle(mask.data(), vertices + t, bounds);
+        }
+
+        for (auto y = ys; y < ye; ++y) {
+          blend_span(&_pixels[y * _width + xs], count, command.Fill,
+                     &mask[(y - ys) * count]);
+        }
+        break;
+      }
+    }
+  }
+}
+
+}  // namespace muchcool::xgdi
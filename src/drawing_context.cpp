@@ -5,11 +5,23 @@
 
 #include "muchcool/xgdi/drawing_context.hpp"
 
+#include "host_buffer.hpp"
+#include "muchcool/xgdi/offscreen_target.hpp"
+#include "pipeline.hpp"
+#include "presenter.hpp"
+#include "render_image.hpp"
+#include "tessellator.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <variant>
+
 #include "src/shader/rect.vert.spv.hpp"
 #include "src/shader/rect.frag.spv.hpp"
 
 #include "src/shader/roundrect.vert.spv.hpp"
 #include "src/shader/roundrect.frag.spv.hpp"
+#include "src/shader/roundrect_fill.frag.spv.hpp"
 
 #include "src/shader/bitmap.vert.spv.hpp"
 #include "src/shader/bitmap.frag.spv.hpp"
@@ -20,28 +32,67 @@
 #include "src/shader/glyph_sdf.vert.spv.hpp"
 #include "src/shader/glyph_sdf.frag.spv.hpp"
 
+#include "src/shader/path.vert.spv.hpp"
+
 #define MAX_DESCRIPTOR_COUNT 4096
 
+#define MAX_OCCLUDER_COUNT 16
+
+// Depth distance between consecutive draws, coarse enough for 24 bit depth.
+#define DEPTH_STEP (1.0f / (1 << 22))
+
+#define PATH_VERTEX_CHUNK_SIZE (64 * 1024 * sizeof(_PathVertex))
+
+#define LAYER_FORMAT vk::Format::eR8G8B8A8Unorm
+
 #define XGDI_DRAW_GLYPH_BOUNDING_BOX false
 
 namespace muchcool::xgdi {
 
-Shared<rndr::GraphicsPipeline> CreatePipeline(
-    Shared<rndr::RenderSurface> renderSurface,
+Shared<Pipeline> CreatePipeline(
+    const Shared<rndr::GraphicsContext>& context,
+    const Shared<rndr::RenderPass>& renderPass,
     Shared<rndr::PipelineLayout> layout,
     ArrayProxy<const uint8> vertexShaderData,
-    ArrayProxy<const uint8> fragmentShaderData) {
-  auto& context = renderSurface->context();
-  auto& renderPass = renderSurface->GetRenderPass();
-
-  auto vertexShader = rndr::Shader::FromData(context, vertexShaderData);
-
-  auto fragmentShader = rndr::Shader::FromData(context, fragmentShaderData);
-
-  return Shared{new rndr::GraphicsPipeline(
-      context, renderPass, layout, vertexShader, fragmentShader, {}, {})};
+    ArrayProxy<const uint8> fragmentShaderData,
+    const vk::PipelineColorBlendAttachmentState& blendState,
+    const vk::PipelineDepthStencilStateCreateInfo& depthState,
+    ArrayProxy<const vk::VertexInputBindingDescription> vertexBindings = {},
+    ArrayProxy<const vk::VertexInputAttributeDescription> vertexAttributes =
+        {}) {
+  return Shared{new Pipeline(context, *renderPass, *layout, vertexShaderData,
+                              fragmentShaderData, blendState, depthState,
+                              vertexBindings, vertexAttributes)};
 }
 
+// Source over for shaders writing straight alpha. Alpha accumulates as
+// a + dst.a * (1 - a), so a target cleared to transparent black ends up
+// holding premultiplied colors, which layers rely on.
+const auto SourceOverBlend = vk::PipelineColorBlendAttachmentState(
+    VK_TRUE, vk::BlendFactor::eSrcAlpha, vk::BlendFactor::eOneMinusSrcAlpha,
+    vk::BlendOp::eAdd, vk::BlendFactor::eOne,
+    vk::BlendFactor::eOneMinusSrcAlpha, vk::BlendOp::eAdd,
+    vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
+        vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA);
+
+// Source over for premultiplied sources, blending them with SourceOverBlend
+// would multiply translucent texels by their alpha a second time.
+const auto PremultipliedSourceOverBlend =
+    vk::PipelineColorBlendAttachmentState(
+        VK_TRUE, vk::BlendFactor::eOne, vk::BlendFactor::eOneMinusSrcAlpha,
+        vk::BlendOp::eAdd, vk::BlendFactor::eOne,
+        vk::BlendFactor::eOneMinusSrcAlpha, vk::BlendOp::eAdd,
+        vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
+            vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA);
+
+// Render surfaces have no depth attachment.
+const auto NoDepthTest = vk::PipelineDepthStencilStateCreateInfo();
+
+// Every draw is nearer than the draws before it, see next_depth. Translucent
+// draws write depth as well, the draws after them are nearer and still pass.
+const auto DepthTest = vk::PipelineDepthStencilStateCreateInfo(
+    {}, VK_TRUE, VK_TRUE, vk::CompareOp::eLess);
+
 // rndr::GraphicsPipeline* CreatePipeline(rndr::RenderSurface* renderSurface,
 //                                        rndr::PipelineLayout* layout,
 //                                        const char* vertexShaderPath,
@@ -62,40 +113,140 @@ Shared<rndr::GraphicsPipeline> CreatePipeline(
 //   return pipeline;
 // }
 
-Shared<rndr::GraphicsPipeline> CreateRectanglePipeline(
-    Shared<rndr::RenderSurface> renderSurface,
-    Shared<rndr::PipelineLayout> layout) {
-  return CreatePipeline(renderSurface, layout, rect_vert_spv, rect_frag_spv);
+Shared<Pipeline> CreateRectanglePipeline(
+    const Shared<rndr::GraphicsContext>& context,
+    const Shared<rndr::RenderPass>& renderPass,
+    Shared<rndr::PipelineLayout> layout,
+    const vk::PipelineDepthStencilStateCreateInfo& depthState) {
+  return CreatePipeline(context, renderPass, layout, rect_vert_spv,
+                        rect_frag_spv, SourceOverBlend, depthState);
+}
+
+Shared<Pipeline> CreateRoundRectPipeline(
+    const Shared<rndr::GraphicsContext>& context,
+    const Shared<rndr::RenderPass>& renderPass,
+    Shared<rndr::PipelineLayout> layout,
+    const vk::PipelineDepthStencilStateCreateInfo& depthState) {
+  return CreatePipeline(context, renderPass, layout, roundrect_vert_spv,
+                        roundrect_frag_spv, SourceOverBlend, depthState);
 }
 
-Shared<rndr::GraphicsPipeline> CreateRoundRectPipeline(
-    Shared<rndr::RenderSurface> renderSurface,
-    Shared<rndr::PipelineLayout> layout) {
-  return CreatePipeline(renderSurface, layout, roundrect_vert_spv,
-                        roundrect_frag_spv);
+Shared<Pipeline> CreateRoundRectFillPipeline(
+    const Shared<rndr::GraphicsContext>& context,
+    const Shared<rndr::RenderPass>& renderPass,
+    Shared<rndr::PipelineLayout> layout,
+    const vk::PipelineDepthStencilStateCreateInfo& depthState) {
+  return CreatePipeline(context, renderPass, layout, roundrect_vert_spv,
+                        roundrect_fill_frag_spv, SourceOverBlend, depthState);
 }
 
-Shared<rndr::GraphicsPipeline> CreateGlyphPipeline(
-    Shared<rndr::RenderSurface> renderSurface,
-    Shared<rndr::PipelineLayout> layout) {
-  return CreatePipeline(renderSurface, layout, glyph_sdf_vert_spv,
-                        glyph_sdf_frag_spv);
+Shared<Pipeline> CreateGlyphPipeline(
+    const Shared<rndr::GraphicsContext>& context,
+    const Shared<rndr::RenderPass>& renderPass,
+    Shared<rndr::PipelineLayout> layout,
+    const vk::PipelineDepthStencilStateCreateInfo& depthState) {
+  return CreatePipeline(context, renderPass, layout, glyph_sdf_vert_spv,
+                        glyph_sdf_frag_spv, SourceOverBlend, depthState);
 }
 
-Shared<rndr::GraphicsPipeline> CreateBitmapPipeline(
-    Shared<rndr::RenderSurface> renderSurface,
-    Shared<rndr::PipelineLayout> layout) {
-  return CreatePipeline(renderSurface, layout, bitmap_vert_spv,
-                        bitmap_frag_spv);
+Shared<Pipeline> CreateBitmapPipeline(
+    const Shared<rndr::GraphicsContext>& context,
+    const Shared<rndr::RenderPass>& renderPass,
+    Shared<rndr::PipelineLayout> layout,
+    const vk::PipelineDepthStencilStateCreateInfo& depthState) {
+  return CreatePipeline(context, renderPass, layout, bitmap_vert_spv,
+                        bitmap_frag_spv, SourceOverBlend, depthState);
+}
+
+Shared<Pipeline> CreatePathPipeline(
+    const Shared<rndr::GraphicsContext>& context,
+    const Shared<rndr::RenderPass>& renderPass,
+    Shared<rndr::PipelineLayout> layout,
+    const vk::PipelineDepthStencilStateCreateInfo& depthState) {
+  const auto bindings = std::array{vk::VertexInputBindingDescription(
+      0, sizeof(_PathVertex), vk::VertexInputRate::eVertex)};
+
+  const auto attributes = std::array{
+      vk::VertexInputAttributeDescription(0, 0, vk::Format::eR32G32B32Sfloat,
+                                          offsetof(_PathVertex, Position)),
+      vk::VertexInputAttributeDescription(1, 0,
+                                          vk::Format::eR32G32B32A32Sfloat,
+                                          offsetof(_PathVertex, Color))};
+
+  return CreatePipeline(context, renderPass, layout, path_vert_spv,
+                        rect_frag_spv, SourceOverBlend, depthState, bindings,
+                        attributes);
+}
+
+Shared<Pipeline> CreateLayerPipeline(
+    const Shared<rndr::GraphicsContext>& context,
+    const Shared<rndr::RenderPass>& renderPass,
+    Shared<rndr::PipelineLayout> layout,
+    const vk::PipelineDepthStencilStateCreateInfo& depthState) {
+  return CreatePipeline(context, renderPass, layout, bitmap_vert_spv,
+                        bitmap_frag_spv, PremultipliedSourceOverBlend,
+                        depthState);
+}
+
+Shared<rndr::DescriptorPool> CreateDescriptorPool(
+    const Shared<rndr::GraphicsContext>& context) {
+  return Shared{new rndr::DescriptorPool(
+      context, MAX_DESCRIPTOR_COUNT,
+      {rndr::DescriptorPoolSize(vk::DescriptorType::eUniformBuffer,
+                                MAX_DESCRIPTOR_COUNT),
+       rndr::DescriptorPoolSize(vk::DescriptorType::eCombinedImageSampler,
+                                MAX_DESCRIPTOR_COUNT)})};
+}
+
+_PipelineSet CreatePipelines(
+    const Shared<rndr::GraphicsContext>& context,
+    const Shared<rndr::RenderPass>& renderPass,
+    const Shared<rndr::PipelineLayout>& layout,
+    const Shared<rndr::PipelineLayout>& sampledLayout, bool depthTested) {
+  auto& depth = depthTested ? DepthTest : NoDepthTest;
+
+  return _PipelineSet{
+      .Rectangle = CreateRectanglePipeline(context, renderPass, layout, depth),
+      .RoundRect = CreateRoundRectPipeline(context, renderPass, layout, depth),
+      .RoundRectFill =
+          CreateRoundRectFillPipeline(context, renderPass, layout, depth),
+      .Glyph = CreateGlyphPipeline(context, renderPass, sampledLayout, depth),
+      .Bitmap = CreateBitmapPipeline(context, renderPass, sampledLayout, depth),
+      .Path = CreatePathPipeline(context, renderPass, layout, depth),
+      .Layer = CreateLayerPipeline(context, renderPass, sampledLayout, depth),
+      .DepthTested = depthTested};
 }
 
 DrawingContext::DrawingContext(Shared<rndr::RenderSurface> surface_)
-    : _renderSurface(std::move(surface_)), _renderInfo() {
-  auto& context = _renderSurface->context();
-  auto& device = context->device();
-  auto& frameBuffers = _renderSurface->GetFrameBuffers();
+    : _renderSurface(std::move(surface_)),
+      _context(_renderSurface->context()),
+      _renderInfo() {
+  auto& device = _context->device();
+
+  // The surface render pass comes from rndr and has no depth attachment.
+  initialize(_renderSurface->GetRenderPass(),
+             _renderSurface->GetFrameBuffers().size(),
+             _renderSurface->GetViewport(), false);
+
+  auto semaphoreCreateInfo = vk::SemaphoreCreateInfo();
+  _imageAvailableSemaphore = device.createSemaphore(semaphoreCreateInfo);
+  _renderFinishedSemaphore = device.createSemaphore(semaphoreCreateInfo);
+}
+
+DrawingContext::DrawingContext(Shared<OffscreenTarget> target_)
+    : _offscreenTarget(std::move(target_)),
+      _context(_offscreenTarget->context()),
+      _renderInfo() {
+  initialize(_offscreenTarget->render_pass(), 1, _offscreenTarget->viewport(),
+             true);
+}
+
+void DrawingContext::initialize(const Shared<rndr::RenderPass>& renderPass,
+                                size_t framebufferCount,
+                                const vk::Viewport& viewport,
+                                bool depthTested) {
+  auto& context = _context;
 
-  auto& viewport = _renderSurface->GetViewport();
   _renderInfo.Projection =
       glm::ortho(0.0f, viewport.width, 0.0f, viewport.height);
 
@@ -123,71 +274,232 @@ DrawingContext::DrawingContext(Shared<rndr::RenderSurface> surface_)
   _sampledPipelineLayout = new rndr::PipelineLayout(
       context, {_renderInfoSetLayout, _modelInfoSetLayout, _glyphSetLayout});
 
-  _rectanglePipeline = CreateRectanglePipeline(_renderSurface, _pipelineLayout);
-  _roundRectPipeline = CreateRoundRectPipeline(_renderSurface, _pipelineLayout);
-  _glyphPipeline = CreateGlyphPipeline(_renderSurface, _sampledPipelineLayout);
-  _bitmapPipeline =
-      CreateBitmapPipeline(_renderSurface, _sampledPipelineLayout);
+  _surfacePipelines = CreatePipelines(context, renderPass, _pipelineLayout,
+                                      _sampledPipelineLayout, depthTested);
+  _pipelines = &_surfacePipelines;
 
   _commandPool = new rndr::CommandPool(context);
 
-  _commandBuffers = _commandPool->AllocateBuffers(frameBuffers.size());
-  _imageTransitionCommands = _commandPool->AllocateBuffer();
+  _framebufferCount = framebufferCount;
+  _frames.emplace_back(create_frame_resources());
+  select_frame(0);
 
   _renderInfoUniformBuffer = new RenderUniformBuffer(context, _renderInfo);
 
-  _descriptorPool = new rndr::DescriptorPool(
-      context, MAX_DESCRIPTOR_COUNT,
-      {rndr::DescriptorPoolSize(vk::DescriptorType::eUniformBuffer,
-                                MAX_DESCRIPTOR_COUNT),
-       rndr::DescriptorPoolSize(vk::DescriptorType::eCombinedImageSampler,
-                                MAX_DESCRIPTOR_COUNT)});
+  _descriptorPool = CreateDescriptorPool(context);
 
   _renderDescriptor = _descriptorPool->allocate(*_renderInfoSetLayout);
   _renderDescriptor->update_uniform(0, *_renderInfoUniformBuffer);
 
-  auto semaphoreCreateInfo = vk::SemaphoreCreateInfo();
-  _imageAvailableSemaphore = device.createSemaphore(semaphoreCreateInfo);
-  _renderFinishedSemaphore = device.createSemaphore(semaphoreCreateInfo);
+  _timestampPool = context->device().createQueryPool(
+      vk::QueryPoolCreateInfo({}, vk::QueryType::eTimestamp,
+                              2 * Presenter::SlotCount));
+  const auto& physicalDevice = context->physical_device();
+  const auto limits = physicalDevice.getProperties().limits;
+  _timestampPeriod = limits.timestampPeriod;
+
+  // The context does not tell which family its queue belongs to, require
+  // timestamps on every graphics family.
+  _timestampsSupported = limits.timestampComputeAndGraphics;
+  if (!_timestampsSupported) {
+    _timestampsSupported = true;
+    for (auto& family : physicalDevice.getQueueFamilyProperties()) {
+      if ((family.queueFlags & vk::QueueFlagBits::eGraphics) &&
+          family.timestampValidBits == 0)
+        _timestampsSupported = false;
+    }
+  }
 }
 
-DrawingContext::~DrawingContext() {}
+DrawingContext::~DrawingContext() {
+  auto& device = _context->device();
+
+  // The last offscreen frame may still use the resources released below. A
+  // destructor has no way to report a lost device, release them regardless.
+  if (_offscreenTarget) {
+    (void)device.waitForFences(_offscreenTarget->fence(), VK_TRUE,
+                               UINT64_MAX);
+  }
+
+  // Frames still queued reference the resources released below.
+  _presenter = nullptr;
+
+  for (auto layer : _layers) layer->_owner = nullptr;
+
+  if (_layerFence) device.destroyFence(_layerFence);
+  if (_layerSampler) device.destroySampler(_layerSampler);
+
+  device.destroyQueryPool(_timestampPool);
+}
 
 void DrawingContext::reset() {
-  for (auto commandBuffer : _commandBuffers) commandBuffer.reset();
+  // Offscreen submits return without waiting for the GPU, the last frame may
+  // still use the command buffers and resources released below.
+  if (_offscreenTarget) {
+    auto& device = _context->device();
+
+    auto result = device.waitForFences(_offscreenTarget->fence(), VK_TRUE,
+                                       UINT64_MAX);
+    if (result != vk::Result::eSuccess)
+      vk::throwResultException(result, "failed to wait for fence.");
+
+    // Recording resets the queries of the frame.
+    if (_timestampsPending && read_gpu_time(*_frameResources))
+      _timestampsPending = false;
+  }
+
+  auto& frame = *_frameResources;
+
+  for (auto commandBuffer : frame.CommandBuffers) commandBuffer.reset();
+
+  frame.ImageTransitionCommands->operator vk::CommandBuffer().reset();
+  frame.RectUniforms.clear();
+  frame.RoundRectUniforms.clear();
+  frame.GlyphUniforms.clear();
+  frame.LayerRenderInfoUniforms.clear();
+
+  // Sets have to be released before the pools they were allocated from.
+  frame.TransformDescriptorSets.clear();
+  frame.GlyphDescriptorSets.clear();
+  frame.OverflowDescriptorPools.clear();
+
+  frame.LayerImages.clear();
+  frame.Glyphs.clear();
+  frame.Textures.clear();
+
+  frame.PathVertexChunk = 0;
+  frame.PathVertexOffset = 0;
+}
+
+Shared<_FrameResources> DrawingContext::create_frame_resources() const {
+  auto frame = Shared{new _FrameResources()};
+  frame->CommandBuffers = _commandPool->AllocateBuffers(_framebufferCount);
+  frame->ImageTransitionCommands = _commandPool->AllocateBuffer();
+  // Every slot owns a pair of queries, frames in flight never share them.
+  frame->FirstTimestamp = 2 * static_cast<uint32>(_frames.size());
+  return frame;
+}
+
+void DrawingContext::select_frame(uint32 slot) {
+  _frameSlot = slot;
+  _frameResources = _frames[slot].get();
+  if (!_recordingLayer) _recordingBuffers = &_frameResources->CommandBuffers;
+}
+
+void DrawingContext::set_submit_mode(SubmitMode mode) {
+  if (mode != SubmitMode::Synchronous && !_renderSurface) {
+    throw std::logic_error{"Presenter threads require a render surface."};
+  }
+
+  // Presents the frames still queued and joins the presenter thread.
+  _presenter = nullptr;
+
+  if (mode == SubmitMode::Synchronous) {
+    select_frame(0);
+    return;
+  }
+
+  while (_frames.size() < Presenter::SlotCount) {
+    _frames.emplace_back(create_frame_resources());
+  }
 
-  _imageTransitionCommands->operator vk::CommandBuffer().reset();
-  _rectUniforms.clear();
-  _roundRectUniforms.clear();
+  _presenter = Shared{new Presenter(
+      mode, [this](uint32 slot) { present_frame(*_frames[slot]); })};
+  select_frame(_presenter->acquire_slot());
+}
+
+template <typename Function>
+void DrawingContext::with_render_lock(Function&& function) const {
+  if (_renderSurface) {
+    auto renderLock = _renderSurface->LockRenderMutex();
+    function();
+  } else {
+    auto renderLock = _offscreenTarget->LockRenderMutex();
+    function();
+  }
+}
+
+Shared<rndr::DescriptorSet> DrawingContext::allocate_descriptor_set(
+    const rndr::DescriptorSetLayout& layout) {
+  ++_frameStats.DescriptorAllocations;
+
+  auto& overflowPools = _frameResources->OverflowDescriptorPools;
+  auto& pool = overflowPools.empty() ? _descriptorPool : overflowPools.back();
+
+  try {
+    return pool->allocate(layout);
+  } catch (const vk::OutOfPoolMemoryError&) {
+  } catch (const vk::FragmentedPoolError&) {
+  }
+
+  // Frames with more draws than a pool holds spill into additional pools,
+  // released again by reset.
+  overflowPools.emplace_back(CreateDescriptorPool(_context));
+  return overflowPools.back()->allocate(layout);
 }
 
 void DrawingContext::start_recording() {
-  auto& renderSurface = *_renderSurface;
-  auto& frameBuffers = renderSurface.GetFrameBuffers();
-  auto& renderPass = renderSurface.GetRenderPass();
-  auto framebufferSize = renderSurface.GetCurrentExtent();
+  ++_frame;
+
+  auto& counters = ResourceCounters::Get();
+  _frameStats = FrameStats{};
+  _counterBaseline = FrameStats{.GlyphCacheHits = counters.GlyphCacheHits,
+                                .GlyphCacheMisses = counters.GlyphCacheMisses,
+                                .GlyphEvictions = counters.GlyphEvictions,
+                                .TexturesCreated = counters.TexturesCreated};
+  _recordingStart = std::chrono::steady_clock::now();
+  _boundPipeline = nullptr;
+  _depthCount = 0;
+
+  _capture = std::move(_pendingCapture);
+
+  auto& renderPass = _renderSurface ? _renderSurface->GetRenderPass()
+                                    : _offscreenTarget->render_pass();
+  auto framebufferSize = _renderSurface ? _renderSurface->GetCurrentExtent()
+                                        : _offscreenTarget->extent();
+  auto viewport = _renderSurface ? _renderSurface->GetViewport()
+                                 : _offscreenTarget->viewport();
+  auto scissor = _renderSurface ? _renderSurface->GetScissor()
+                                : _offscreenTarget->scissor();
+
+  if (_capture) _capture->clear(framebufferSize.width, framebufferSize.height);
+
+  auto& frame = *_frameResources;
 
   auto commandxBeginInfo = vk::CommandBufferBeginInfo();
-  _imageTransitionCommands->operator vk::CommandBuffer().begin(
+  frame.ImageTransitionCommands->operator vk::CommandBuffer().begin(
       commandxBeginInfo);
 
-  for (int i = 0; i < _commandBuffers.size(); ++i) {
-    auto& commandBuffer = _commandBuffers[i];
+  for (int i = 0; i < frame.CommandBuffers.size(); ++i) {
+    auto& commandBuffer = frame.CommandBuffers[i];
 
     auto commandBeginInfo = vk::CommandBufferBeginInfo();
     commandBuffer.begin(commandBeginInfo);
 
-    auto clearColor = vk::ClearValue(
-        vk::ClearColorValue(std::array<float, 4>({0.0f, 0.0f, 0.0f, 0.0f})));
+    if (_timestampsSupported) {
+      commandBuffer.resetQueryPool(_timestampPool, frame.FirstTimestamp, 2);
+      commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe,
+                                   _timestampPool, frame.FirstTimestamp);
+    }
+
+    // Render surfaces ignore the depth clear value.
+    auto clearValues = std::array{
+        vk::ClearValue(vk::ClearColorValue(
+            std::array<float, 4>({0.0f, 0.0f, 0.0f, 0.0f}))),
+        vk::ClearValue(vk::ClearDepthStencilValue(1.0f, 0))};
+
+    auto frameBuffer =
+        _renderSurface ? vk::Framebuffer(_renderSurface->GetFrameBuffers()[i])
+                       : _offscreenTarget->framebuffer();
 
     auto renderPassBeginInfo = vk::RenderPassBeginInfo(
-        *renderPass, frameBuffers[i], vk::Rect2D({0, 0}, framebufferSize), 1,
-        &clearColor);
+        *renderPass, frameBuffer, vk::Rect2D({0, 0}, framebufferSize),
+        clearValues);
     commandBuffer.beginRenderPass(renderPassBeginInfo,
                                   vk::SubpassContents::eInline);
 
-    commandBuffer.setViewport(0, renderSurface.GetViewport());
-    commandBuffer.setScissor(0, renderSurface.GetScissor());
+    commandBuffer.setViewport(0, viewport);
+    commandBuffer.setScissor(0, scissor);
 
     auto renderDescriptorSets =
         std::array<vk::DescriptorSet, 1>{*_renderDescriptor};
@@ -198,14 +510,145 @@ void DrawingContext::start_recording() {
 }
 
 void DrawingContext::end_recording() {
-  _imageTransitionCommands->operator vk::CommandBuffer().end();
-  for (auto commandBuffer : _commandBuffers) {
+  flush_deferred_draws();
+
+  auto& frame = *_frameResources;
+
+  frame.ImageTransitionCommands->operator vk::CommandBuffer().end();
+  for (auto commandBuffer : frame.CommandBuffers) {
     commandBuffer.endRenderPass();
+    if (_timestampsSupported) {
+      commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe,
+                                   _timestampPool, frame.FirstTimestamp + 1);
+    }
+    if (_offscreenTarget) _offscreenTarget->record_readback(commandBuffer);
     commandBuffer.end();
   }
+
+  // The thread's counters were sampled at start_recording, report the
+  // difference.
+  auto& counters = ResourceCounters::Get();
+  _frameStats.GlyphCacheHits +=
+      counters.GlyphCacheHits - _counterBaseline.GlyphCacheHits;
+  _frameStats.GlyphCacheMisses +=
+      counters.GlyphCacheMisses - _counterBaseline.GlyphCacheMisses;
+  _frameStats.GlyphEvictions +=
+      counters.GlyphEvictions - _counterBaseline.GlyphEvictions;
+  _frameStats.TexturesCreated +=
+      counters.TexturesCreated - _counterBaseline.TexturesCreated;
+
+  _frameStats.CpuRecordingMs =
+      std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - _recordingStart)
+          .count();
+  _frameStats.GpuMs = _gpuMs;
+
+  _lastFrameStats = _frameStats;
+  _capture = nullptr;
+}
+
+const FrameStats& DrawingContext::frame_stats() const {
+  if (_timestampsPending && read_gpu_time(*_frameResources))
+    _timestampsPending = false;
+
+  _lastFrameStats.GpuMs = _gpuMs;
+  return _lastFrameStats;
+}
+
+bool DrawingContext::read_gpu_time(const _FrameResources& frame) const {
+  if (!_timestampsSupported) return false;
+
+  auto& device = _context->device();
+
+  auto results = device.getQueryPoolResults<uint64>(
+      _timestampPool, frame.FirstTimestamp, 2, 2 * sizeof(uint64),
+      sizeof(uint64), vk::QueryResultFlagBits::e64);
+  if (results.result != vk::Result::eSuccess) return false;
+
+  auto& timestamps = results.value;
+  _gpuMs = (timestamps[1] - timestamps[0]) * _timestampPeriod / 1e6;
+  return true;
+}
+
+void DrawingContext::draw_frame_stats(const Point& point,
+                                      const Shared<Font>& font) {
+  auto& stats = frame_stats();
+
+  char buffer[512];
+  std::snprintf(
+      buffer, sizeof(buffer),
+      "draws %u (culled %u)\n"
+      "pipeline binds %u\n"
+      "descriptor sets %u\n"
+      "uniforms %llu B, vertices %llu B\n"
+      "glyphs %llu hits, %llu misses, %llu evicted\n"
+      "textures created %llu\n"
+      "cpu %.2f ms, gpu %.2f ms",
+      stats.Draws, stats.CulledDraws, stats.PipelineBinds,
+      stats.DescriptorAllocations, (unsigned long long)stats.UniformBytes,
+      (unsigned long long)stats.VertexBytes,
+      (unsigned long long)stats.GlyphCacheHits,
+      (unsigned long long)stats.GlyphCacheMisses,
+      (unsigned long long)stats.GlyphEvictions,
+      (unsigned long long)stats.TexturesCreated, stats.CpuRecordingMs,
+      stats.GpuMs);
+
+  constexpr auto lines = 7;
+  constexpr auto columns = 44;
+  constexpr auto padding = 8.0f;
+
+  auto size = Size{columns * font->glyph('0')->advance() + 2 * padding,
+                   lines * font->line_height() + 2 * padding};
+
+  draw_rectangle(Rect{point, size}, Color(0.0f, 0.0f, 0.0f, 0.75f));
+  draw_formatted_text(point + Point{padding, padding + font->ascender()},
+                      FormattedText(font, buffer), Color::White);
+}
+
+void DrawingContext::submit_offscreen() const {
+  auto& device = _context->device();
+  auto& queue = _context->queue();
+  auto& fence = _offscreenTarget->fence();
+
+  // The previous frame may still be copying into the readback buffer.
+  auto result = device.waitForFences(fence, VK_TRUE, UINT64_MAX);
+  if (result != vk::Result::eSuccess)
+    vk::throwResultException(result, "failed to wait for fence.");
+  device.resetFences(fence);
+
+  auto& frame = *_frameResources;
+  auto commandBuffers = std::array<vk::CommandBuffer, 2>{
+      *frame.ImageTransitionCommands, frame.CommandBuffers.front()};
+
+  auto submitInfo = vk::SubmitInfo({}, {}, commandBuffers);
+
+  with_render_lock([&] {
+    result = queue.submit(1, &submitInfo, fence);
+    if (result != vk::Result::eSuccess)
+      vk::throwResultException(result,
+                               "failed to submit command buffers to queue.");
+  });
+
+  _timestampsPending = _timestampsSupported;
+}
+
+void DrawingContext::submit() {
+  if (_offscreenTarget) {
+    submit_offscreen();
+    return;
+  }
+
+  if (!_presenter) {
+    present_frame(*_frameResources);
+    return;
+  }
+
+  // Recording continues in another slot while the presenter thread submits.
+  _presenter->push(_frameSlot);
+  select_frame(_presenter->acquire_slot());
 }
 
-void DrawingContext::submit() const {
+void DrawingContext::present_frame(const _FrameResources& frame) const {
   auto& renderSurface = *_renderSurface;
   auto& context = *renderSurface.context();
   auto& device = context.device();
@@ -215,8 +658,8 @@ void DrawingContext::submit() const {
 
   auto& inFlightFence = renderSurface.GetInFlightFence();
 
-  auto renderLock = renderSurface.LockRenderMutex();
-
+  // Only this thread uses the swapchain and the fence, the render lock only
+  // guards the queue.
   uint32_t nextImageIndex = 0;
   auto result = device.acquireNextImageKHR(
       swapchain, UINT64_MAX, _imageAvailableSemaphore, null, &nextImageIndex);
@@ -224,10 +667,10 @@ void DrawingContext::submit() const {
     vk::throwResultException(result, "failed to acquire next frame.");
   }
 
-  auto& commandBuffer = _commandBuffers[nextImageIndex];
+  auto& commandBuffer = frame.CommandBuffers[nextImageIndex];
 
   auto commandBuffers = std::array<vk::CommandBuffer, 2>{
-      *_imageTransitionCommands, commandBuffer};
+      *frame.ImageTransitionCommands, commandBuffer};
 
   auto submitSemaphore = std::array<vk::Semaphore, 1>{_imageAvailableSemaphore};
 
@@ -238,53 +681,197 @@ void DrawingContext::submit() const {
   auto submitInfo = vk::SubmitInfo(submitSemaphore, submitStage, commandBuffers,
                                    _renderFinishedSemaphore);
 
-  result = queue.submit(1, &submitInfo, inFlightFence);
-  if (result != vk::Result::eSuccess)
-    vk::throwResultException(result,
-                             "failed to submit command buffers to queue.");
-
   auto presentInfo =
       vk::PresentInfoKHR(_renderFinishedSemaphore, swapchain, nextImageIndex);
 
-  result = queue.presentKHR(&presentInfo);
-  if (result != vk::Result::eSuccess) {
-    vk::throwResultException(result, "failed to present.");
-  }
+  with_render_lock([&] {
+    result = queue.submit(1, &submitInfo, inFlightFence);
+    if (result != vk::Result::eSuccess)
+      vk::throwResultException(result,
+                               "failed to submit command buffers to queue.");
+
+    result = queue.presentKHR(&presentInfo);
+    if (result != vk::Result::eSuccess) {
+      vk::throwResultException(result, "failed to present.");
+    }
+  });
 
   result = device.waitForFences(inFlightFence, VK_TRUE, UINT64_MAX);
   if (result != vk::Result::eSuccess)
     vk::throwResultException(result, "failed to wait for fence.");
   device.resetFences(inFlightFence);
+
+  read_gpu_time(frame);
 }
 
-glm::mat4 model_projection(const Rect& rect, float rotation = 0.0f) {
-  return glm::translate(glm::vec3(rect.Offset, 0.0f)) *
+// The projection maps z to -z, the depth ends up in the depth buffer as is.
+glm::mat4 model_projection(const Rect& rect, float depth,
+                           float rotation = 0.0f) {
+  return glm::translate(glm::vec3(rect.Offset, -depth)) *
          glm::rotate(rotation, glm::vec3(0.0f, 0.0f, 1.0f)) *
          glm::scale(glm::vec3(rect.Size, 0.0f));
 }
 
+// Returns the rect with a positive size covering the same area.
+Rect normalized(const Rect& rect) {
+  auto min = glm::min(rect.Offset, rect.Offset + rect.Size);
+  auto max = glm::max(rect.Offset, rect.Offset + rect.Size);
+  return Rect{min, max - min};
+}
+
+Rect inset(const Rect& rect, float amount) {
+  auto r = normalized(rect);
+  auto size = glm::max(r.Size - 2.0f * amount, glm::vec2(0.0f));
+  return Rect{r.Offset + amount, size};
+}
+
+bool contains(const Rect& outer, const Rect& inner) {
+  return inner.Offset.x >= outer.Offset.x && inner.Offset.y >= outer.Offset.y &&
+         inner.Offset.x + inner.Size.x <= outer.Offset.x + outer.Size.x &&
+         inner.Offset.y + inner.Size.y <= outer.Offset.y + outer.Size.y;
+}
+
+float area(const Rect& rect) { return rect.Size.x * rect.Size.y; }
+
+// Opaque rects and bitmaps cover every pixel of their bounds completely. Round
+// rects are only guaranteed to cover their occluder, the inner rect.
+bool opaque_fragments(const _DeferredDraw& draw) {
+  return area(draw.Occluder) > 0.0f &&
+         (std::holds_alternative<_RectangleDraw>(draw.Record) ||
+          std::holds_alternative<_BitmapDraw>(draw.Record));
+}
+
+void DrawingContext::set_occlusion_culling(bool enabled) {
+  // Draws deferred so far stay ahead of the ones that follow.
+  flush_deferred_draws();
+  _occlusionCulling = enabled;
+}
+
+float DrawingContext::next_depth() {
+  if (!_pipelines->DepthTested) return 0.0f;
+
+  // Frames with more draws than depth steps draw the rest at the near plane,
+  // where they hide each other.
+  return std::max(1.0f - static_cast<float>(++_depthCount) * DEPTH_STEP, 0.0f);
+}
+
+void DrawingContext::capture_frame(Shared<FrameTrace> trace) {
+  _pendingCapture = std::move(trace);
+}
+
+FrameTrace* DrawingContext::capturing() const {
+  return _recordingLayer ? nullptr : _capture.get();
+}
+
+void DrawingContext::bind_pipeline(const Pipeline& pipeline) {
+  auto handle = vk::Pipeline(pipeline);
+  if (handle == _boundPipeline) return;
+
+  _boundPipeline = handle;
+  ++_frameStats.PipelineBinds;
+
+  for (auto& commandBuffer : *_recordingBuffers) {
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, handle);
+  }
+}
+
+void DrawingContext::enqueue_draw(const Rect& bounds, const Rect& occluder,
+                                  _DrawRecord&& record) {
+  if (!_occlusionCulling) {
+    ++_frameStats.Draws;
+    std::visit([this](auto& draw) { record_draw(draw); }, record);
+    return;
+  }
+
+  _deferredDraws.emplace_back(_DeferredDraw{.Bounds = normalized(bounds),
+                                            .Occluder = normalized(occluder),
+                                            .Record = std::move(record)});
+}
+
+void DrawingContext::flush_deferred_draws() {
+  std::array<Rect, MAX_OCCLUDER_COUNT> occluders;
+  size_t occluderCount = 0;
+
+  // Walk from the top most primitive down, dropping every primitive hidden
+  // behind an opaque primitive drawn after it.
+  for (auto it = _deferredDraws.rbegin(); it != _deferredDraws.rend(); ++it) {
+    auto& draw = *it;
+
+    for (size_t i = 0; i < occluderCount; ++i) {
+      if (contains(occluders[i], draw.Bounds)) {
+        draw.Culled = true;
+        break;
+      }
+    }
+
+    if (draw.Culled || area(draw.Occluder) <= 0.0f) continue;
+
+    if (occluderCount < occluders.size()) {
+      occluders[occluderCount++] = draw.Occluder;
+    } else {
+      // Keep the largest occluders, they hide the most.
+      auto smallest = std::min_element(
+          occluders.begin(), occluders.end(),
+          [](auto& a, auto& b) { return area(a) < area(b); });
+      if (area(*smallest) < area(draw.Occluder)) *smallest = draw.Occluder;
+    }
+  }
+
+  auto record = [this](const _DeferredDraw& draw) {
+    ++_frameStats.Draws;
+    std::visit([this](auto& record) { record_draw(record); }, draw.Record);
+  };
+
+  auto depthTested = _pipelines->DepthTested;
+
+  // With a depth attachment opaque primitives go first, nearest first, so
+  // the depth test rejects the fragments they hide before shading them.
+  if (depthTested) {
+    for (auto it = _deferredDraws.rbegin(); it != _deferredDraws.rend(); ++it) {
+      if (!it->Culled && opaque_fragments(*it)) record(*it);
+    }
+  }
+
+  // The rest keeps its original order so blending is unchanged.
+  for (auto& draw : _deferredDraws) {
+    if (draw.Culled) {
+      ++_frameStats.CulledDraws;
+    } else if (!depthTested || !opaque_fragments(draw)) {
+      record(draw);
+    }
+  }
+
+  _deferredDraws.clear();
+}
+
 void DrawingContext::draw_rectangle(const Rect& rect, const Color& color) {
-  auto& graphicsContext = _renderSurface->context();
-  auto& viewport = _renderSurface->GetViewport();
+  if (auto trace = capturing()) trace->record_rectangle(rect, color);
+
+  auto occluder = color.a >= 1.0f ? rect : Rect{};
+  auto info = _RectangleInfo{.Model = model_projection(rect, next_depth()),
+                             .Color = color};
+
+  enqueue_draw(rect, occluder, _RectangleDraw{info});
+}
 
-  auto transformInfo =
-      _RectangleInfo{.Model = model_projection(rect), .Color = color};
+void DrawingContext::record_draw(const _RectangleDraw& draw) {
+  auto& graphicsContext = _context;
 
   auto uniformBuffer =
-      Shared{new RectUniformBuffer(graphicsContext, transformInfo)};
-  _rectUniforms.emplace_back(uniformBuffer);
+      Shared{new RectUniformBuffer(graphicsContext, draw.Info)};
+  _frameStats.UniformBytes += sizeof(draw.Info);
+  _frameResources->RectUniforms.emplace_back(uniformBuffer);
 
-  auto descriptorSet = _descriptorPool->allocate(*_modelInfoSetLayout);
+  auto descriptorSet = allocate_descriptor_set(*_modelInfoSetLayout);
   descriptorSet->update_uniform(0, *uniformBuffer);
-  _transformDescriptorSets.emplace_back(descriptorSet);
+  _frameResources->TransformDescriptorSets.emplace_back(descriptorSet);
 
   auto transformDescriptorSets =
       std::array<vk::DescriptorSet, 1>{*descriptorSet};
 
-  for (auto commandBuffer : _commandBuffers) {
-    commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics,
-                               *_rectanglePipeline);
+  bind_pipeline(*_pipelines->Rectangle);
 
+  for (auto& commandBuffer : *_recordingBuffers) {
     commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
                                      *_pipelineLayout, 1,
                                      transformDescriptorSets, {});
@@ -298,46 +885,60 @@ void DrawingContext::draw_line(const Point& start, const Point& end,
   auto width = glm::length(end - start);
   auto rect = Rect{start, {width, thickness}};
 
-  auto roundRectInfo = _RoundRectInfo{.Model = model_projection(rect),
-                                      .FillColor = color,
-                                      .ModelSize = rect.Size};
-
-  draw_rectangle(roundRectInfo);
+  // Lines have neither corners nor a stroke, the flat rect shader suffices.
+  draw_rectangle(rect, color);
 }
 
 void DrawingContext::draw_rectangle(const Rect& rect, const Size& radius,
                                     const Color& fill, const Color& stroke,
                                     float strokeThickness) {
+  const auto stroked = strokeThickness > 0.0f;
+
+  // Pick the cheapest shader variant able to represent the rectangle.
+  if (!stroked && radius.x <= 0.0f) {
+    draw_rectangle(rect, fill);
+    return;
+  }
+
+  if (auto trace = capturing())
+    trace->record_rectangle(rect, radius, fill, stroke, strokeThickness);
+
   auto roundRectInfo =
-      _RoundRectInfo{.Model = model_projection(rect),
+      _RoundRectInfo{.Model = model_projection(rect, next_depth()),
                      .FillColor = fill,
                      .StrokeColor = stroke,
                      .ModelSize = rect.Size,
                      .CornerRadius = radius,
                      .StrokeThickness = glm::vec1(strokeThickness)};
 
-  draw_rectangle(roundRectInfo);
+  // Only the area inside the corners is guaranteed to be covered.
+  auto opaque = fill.a >= 1.0f && (!stroked || stroke.a >= 1.0f);
+  auto occluder = opaque ? inset(rect, std::max(radius.x, 0.0f)) : Rect{};
+
+  enqueue_draw(rect, occluder, _RoundRectDraw{roundRectInfo, stroked});
 }
 
-void DrawingContext::draw_rectangle(const _RoundRectInfo& roundRectInfo) {
-  auto& graphicsContext = _renderSurface->context();
-  auto& viewport = _renderSurface->GetViewport();
+void DrawingContext::record_draw(const _RoundRectDraw& draw) {
+  auto& graphicsContext = _context;
 
   auto uniformBuffer =
-      Shared{new RoundRectUniformBuffer(graphicsContext, roundRectInfo)};
-  _roundRectUniforms.emplace_back(uniformBuffer);
+      Shared{new RoundRectUniformBuffer(graphicsContext, draw.Info)};
+  _frameStats.UniformBytes += sizeof(draw.Info);
+  _frameResources->RoundRectUniforms.emplace_back(uniformBuffer);
 
-  auto descriptorSet = _descriptorPool->allocate(*_modelInfoSetLayout);
+  auto descriptorSet = allocate_descriptor_set(*_modelInfoSetLayout);
   descriptorSet->update_uniform(0, *uniformBuffer);
-  _transformDescriptorSets.emplace_back(descriptorSet);
+  _frameResources->TransformDescriptorSets.emplace_back(descriptorSet);
 
   auto transformDescriptorSets =
       std::array<vk::DescriptorSet, 1>{*descriptorSet};
 
-  for (auto& commandBuffer : _commandBuffers) {
-    commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics,
-                               *_roundRectPipeline);
+  auto& pipeline =
+      draw.Stroked ? _pipelines->RoundRect : _pipelines->RoundRectFill;
+
+  bind_pipeline(*pipeline);
 
+  for (auto& commandBuffer : *_recordingBuffers) {
     commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
                                      *_pipelineLayout, 1,
                                      transformDescriptorSets, {});
@@ -346,110 +947,462 @@ void DrawingContext::draw_rectangle(const _RoundRectInfo& roundRectInfo) {
   }
 }
 
+void DrawingContext::draw_polyline(ArrayProxy<const Point> points,
+                                   const Color& color,
+                                   const StrokeStyle& style) {
+  if (auto trace = capturing()) trace->record_polyline(points, color, style);
+
+  _tessellation.clear();
+  tessellate_stroke(points, false, style, _tessellation);
+
+  draw_triangles(_tessellation.size(), color, color);
+}
+
+void DrawingContext::draw_path(const Path& path, const Color& fill,
+                               const Color& stroke, const StrokeStyle& style) {
+  if (auto trace = capturing()) trace->record_path(path, fill, stroke, style);
+
+  auto& points = path.points();
+
+  _tessellation.clear();
+
+  if (fill.a > 0.0f) {
+    for (auto& subPath : path.sub_paths()) {
+      tessellate_fill({subPath.Count, points.data() + subPath.First},
+                      _tessellation);
+    }
+  }
+
+  const auto fillCount = _tessellation.size();
+
+  if (stroke.a > 0.0f) {
+    for (auto& subPath : path.sub_paths()) {
+      tessellate_stroke({subPath.Count, points.data() + subPath.First},
+                        subPath.Closed, style, _tessellation);
+    }
+  }
+
+  draw_triangles(fillCount, fill, stroke);
+}
+
+void DrawingContext::draw_triangles(size_t fillCount, const Color& fill,
+                                    const Color& stroke) {
+  const auto count = _tessellation.size();
+  if (count == 0) return;
+
+  const auto size = count * sizeof(_PathVertex);
+  _frameStats.VertexBytes += size;
+
+  auto& frame = *_frameResources;
+  auto& chunks = frame.PathVertexBuffers;
+
+  // Sub-allocate from the frame's vertex chunks, skipping any chunk too small.
+  while (frame.PathVertexChunk < chunks.size() &&
+         frame.PathVertexOffset + size >
+             chunks[frame.PathVertexChunk]->size()) {
+    ++frame.PathVertexChunk;
+    frame.PathVertexOffset = 0;
+  }
+
+  if (frame.PathVertexChunk == chunks.size()) {
+    chunks.emplace_back(new HostBuffer(
+        _context, std::max<vk::DeviceSize>(size, PATH_VERTEX_CHUNK_SIZE),
+        vk::BufferUsageFlagBits::eVertexBuffer));
+  }
+
+  auto& chunk = *chunks[frame.PathVertexChunk];
+  auto buffer = vk::Buffer(chunk);
+  const auto offset = frame.PathVertexOffset;
+  frame.PathVertexOffset += size;
+
+  auto* vertices = reinterpret_cast<_PathVertex*>(
+      static_cast<uint8*>(chunk.data()) + offset);
+
+  // The stroke lies on top of the fill. With depth testing each of them
+  // covers a pixel once, even where its triangles overlap.
+  const auto fillDepth = next_depth();
+  const auto strokeDepth = fillCount < count ? next_depth() : fillDepth;
+
+  auto min = _tessellation.front();
+  auto max = _tessellation.front();
+
+  for (size_t i = 0; i < count; ++i) {
+    const auto isFill = i < fillCount;
+    vertices[i] = _PathVertex{
+        .Position = glm::vec3(_tessellation[i],
+                              isFill ? -fillDepth : -strokeDepth),
+        .Color = isFill ? fill : stroke};
+    min = glm::min(min, _tessellation[i]);
+    max = glm::max(max, _tessellation[i]);
+  }
+
+  enqueue_draw(Rect{min, max - min}, Rect{},
+               _TrianglesDraw{buffer, offset, static_cast<uint32>(count)});
+}
+
+void DrawingContext::record_draw(const _TrianglesDraw& draw) {
+  bind_pipeline(*_pipelines->Path);
+
+  for (auto& commandBuffer : *_recordingBuffers) {
+    commandBuffer.bindVertexBuffers(0, draw.Buffer, draw.Offset);
+    commandBuffer.draw(draw.Count, 1, 0, 0);
+  }
+}
+
 void DrawingContext::draw_custom(DrawCustomCallback callback) {
-  for (auto& commandBuffer : _commandBuffers) callback(commandBuffer);
+  // The footprint of custom commands is unknown, so they are never culled.
+  constexpr auto extent = std::numeric_limits<float>::max();
+  auto bounds = Rect{Point(-extent / 2), Size(extent)};
+
+  enqueue_draw(bounds, Rect{}, _CustomDraw{callback});
 }
 
-bool isControlChar(char16_t c) { return c <= 0x1F; }
+void DrawingContext::record_draw(const _CustomDraw& draw) {
+  for (auto& commandBuffer : *_recordingBuffers) draw.Callback(commandBuffer);
+
+  // The callback may have bound a pipeline of its own.
+  _boundPipeline = nullptr;
+}
+
+Shared<Layer> DrawingContext::create_layer(uint32 width, uint32 height) {
+  return Shared{new Layer(this, width, height)};
+}
+
+void DrawingContext::set_layer_budget(vk::DeviceSize bytes) {
+  _layerBudget = bytes;
+  evict_layers();
+}
+
+void DrawingContext::touch_layer(Layer& layer) {
+  if (layer._owner != this) {
+    throw std::logic_error{"The layer belongs to another DrawingContext."};
+  }
+
+  _layers.splice(_layers.begin(), _layers, layer._lruEntry);
+  layer._lastUsedFrame = _frame;
+}
+
+void DrawingContext::evict_layers() {
+  for (auto it = _layers.rbegin();
+       it != _layers.rend() && _layerMemory > _layerBudget; ++it) {
+    auto& layer = **it;
+    if (!layer._image || layer._lastUsedFrame == _frame) continue;
+
+    _layerMemory -= layer._image->memory_size();
+    layer._image = {};
+    layer._valid = false;
+  }
+}
+
+void DrawingContext::create_layer_resources() {
+  auto& context = _context;
+  auto& device = context->device();
+
+  _layerRenderPass = create_offscreen_render_pass(
+      context, LAYER_FORMAT, vk::ImageLayout::eShaderReadOnlyOptimal);
+
+  _layerPipelines = CreatePipelines(context, _layerRenderPass, _pipelineLayout,
+                                    _sampledPipelineLayout, true);
+
+  _layerCommandBuffers = _commandPool->AllocateBuffers(1);
+  _layerFence = device.createFence(vk::FenceCreateInfo());
+
+  _layerSampler = device.createSampler(vk::SamplerCreateInfo(
+      {}, vk::Filter::eLinear, vk::Filter::eLinear,
+      vk::SamplerMipmapMode::eNearest, vk::SamplerAddressMode::eClampToEdge,
+      vk::SamplerAddressMode::eClampToEdge,
+      vk::SamplerAddressMode::eClampToEdge));
+}
+
+bool DrawingContext::begin_layer(Layer& layer) {
+  if (_recordingLayer) {
+    throw std::logic_error{"Layers can not be nested."};
+  }
+
+  touch_layer(layer);
+  if (layer._valid) return false;
+
+  auto& context = _context;
+
+  if (!_layerRenderPass) create_layer_resources();
+
+  // Pending draws belong to the frame, record them before redirecting.
+  flush_deferred_draws();
+
+  // Frames in flight may still sample the old contents. They keep the old
+  // image alive, the layer renders into a new one.
+  if (layer._image && layer._image.use_count() > 1) {
+    _layerMemory -= layer._image->memory_size();
+    layer._image = {};
+  }
+
+  if (!layer._image) {
+    layer._image = new RenderImage(context, *_layerRenderPass, layer._width,
+                                   layer._height, LAYER_FORMAT,
+                                   vk::ImageUsageFlagBits::eSampled);
+    _layerMemory += layer._image->memory_size();
+    ++_frameStats.TexturesCreated;
+    evict_layers();
+  }
+
+  auto extent = layer._image->extent();
+
+  auto renderInfo = _RenderInfo{
+      .Projection = glm::ortho(0.0f, static_cast<float>(extent.width), 0.0f,
+                               static_cast<float>(extent.height)),
+      .View = _renderInfo.View};
+
+  auto uniformBuffer = Shared{new RenderUniformBuffer(context, renderInfo)};
+  _frameStats.UniformBytes += sizeof(renderInfo);
+  _frameResources->LayerRenderInfoUniforms.emplace_back(uniformBuffer);
+
+  auto renderDescriptor = allocate_descriptor_set(*_renderInfoSetLayout);
+  renderDescriptor->update_uniform(0, *uniformBuffer);
+  _frameResources->TransformDescriptorSets.emplace_back(renderDescriptor);
+
+  auto& commandBuffer = _layerCommandBuffers.front();
+  commandBuffer.reset();
+  commandBuffer.begin(vk::CommandBufferBeginInfo(
+      vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+
+  auto clearValues = std::array{
+      vk::ClearValue(vk::ClearColorValue(
+          std::array<float, 4>({0.0f, 0.0f, 0.0f, 0.0f}))),
+      vk::ClearValue(vk::ClearDepthStencilValue(1.0f, 0))};
+
+  auto renderPassBeginInfo = vk::RenderPassBeginInfo(
+      *_layerRenderPass, layer._image->framebuffer(),
+      vk::Rect2D({0, 0}, extent), clearValues);
+  commandBuffer.beginRenderPass(renderPassBeginInfo,
+                                vk::SubpassContents::eInline);
+
+  commandBuffer.setViewport(
+      0, vk::Viewport(0.0f, 0.0f, static_cast<float>(extent.width),
+                      static_cast<float>(extent.height), 0.0f, 1.0f));
+  commandBuffer.setScissor(0, vk::Rect2D({0, 0}, extent));
+
+  auto renderDescriptorSets =
+      std::array<vk::DescriptorSet, 1>{*renderDescriptor};
+  commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+                                   *_pipelineLayout, 0, renderDescriptorSets,
+                                   {});
+
+  _recordingLayer = &layer;
+  _recordingBuffers = &_layerCommandBuffers;
+  _pipelines = &_layerPipelines;
+  _boundPipeline = nullptr;
+
+  return true;
+}
+
+void DrawingContext::end_layer() {
+  if (!_recordingLayer) {
+    throw std::logic_error{"end_layer called without begin_layer."};
+  }
+
+  flush_deferred_draws();
+
+  auto& commandBuffer = _layerCommandBuffers.front();
+  commandBuffer.endRenderPass();
+  commandBuffer.end();
+
+  auto& device = _context->device();
+  auto& queue = _context->queue();
+
+  // Layers are rendered rarely, rendering them synchronously keeps them out
+  // of the frame's submission entirely.
+  with_render_lock([&] {
+    auto submitInfo = vk::SubmitInfo({}, {}, commandBuffer);
+    auto result = queue.submit(1, &submitInfo, _layerFence);
+    if (result != vk::Result::eSuccess)
+      vk::throwResultException(result, "failed to submit layer commands.");
+  });
+
+  auto result = device.waitForFences(_layerFence, VK_TRUE, UINT64_MAX);
+  if (result != vk::Result::eSuccess)
+    vk::throwResultException(result, "failed to wait for fence.");
+  device.resetFences(_layerFence);
+
+  _recordingLayer->_valid = true;
+
+  _recordingLayer = nullptr;
+  _recordingBuffers = &_frameResources->CommandBuffers;
+  _pipelines = &_surfacePipelines;
+  _boundPipeline = nullptr;
+}
+
+void DrawingContext::draw_layer(const Rect& rect, Layer& layer) {
+  if (&layer == _recordingLayer) {
+    throw std::logic_error{"A layer can not be drawn into itself."};
+  }
+
+  touch_layer(layer);
+  if (!layer._valid) return;
+
+  auto info =
+      _RectangleInfo{.Model = model_projection(rect, next_depth()),
+                     .Color = Color::White};
+
+  enqueue_draw(rect, Rect{}, _LayerDraw{info, layer._image});
+}
+
+void DrawingContext::record_draw(const _LayerDraw& draw) {
+  auto& graphicsContext = _context;
+  auto& device = graphicsContext->device();
+
+  auto uniformBuffer =
+      Shared{new RectUniformBuffer(graphicsContext, draw.Info)};
+  _frameStats.UniformBytes += sizeof(draw.Info);
+  _frameResources->RectUniforms.emplace_back(uniformBuffer);
+
+  auto descriptorSet = allocate_descriptor_set(*_modelInfoSetLayout);
+  descriptorSet->update_uniform(0, *uniformBuffer);
+  _frameResources->TransformDescriptorSets.emplace_back(descriptorSet);
+
+  auto samplerSet = allocate_descriptor_set(*_glyphSetLayout);
+  auto imageInfo =
+      vk::DescriptorImageInfo(_layerSampler, draw.Image->view(),
+                              vk::ImageLayout::eShaderReadOnlyOptimal);
+  device.updateDescriptorSets(
+      vk::WriteDescriptorSet(*samplerSet, 0, 0,
+                             vk::DescriptorType::eCombinedImageSampler,
+                             imageInfo),
+      {});
+  _frameResources->GlyphDescriptorSets.emplace_back(samplerSet);
+  _frameResources->LayerImages.emplace_back(draw.Image);
+
+  auto descriptorSets =
+      std::array<vk::DescriptorSet, 2>{*descriptorSet, *samplerSet};
+
+  bind_pipeline(*_pipelines->Layer);
+
+  for (auto& commandBuffer : *_recordingBuffers) {
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+                                     *_sampledPipelineLayout, 1,
+                                     descriptorSets, {});
+
+    commandBuffer.draw(6, 1, 0, 0);
+  }
+}
 
 void DrawingContext::draw_formatted_text(const Point& point,
                                          const FormattedText& text,
                                          const Color& color) {
+  if (auto trace = capturing())
+    trace->record_formatted_text(point, text, color);
+
   auto& font = text.font();
 
-  auto p = glm::round(point);  // Keeps text pixel aligned
+  auto origin = glm::round(point);  // Keeps text pixel aligned
 
-  for (auto c : text.text()) {
-    if (!isControlChar(c)) {
-      auto& glyph = font->glyph(c);
-      if (glyph.texture()) draw_glyph(p, glyph, color);
-      p.x += glyph.advance();
-    } else {
-      if (c == '\n') {
-        p.x = point.x;  // TODO : Fix text pixel alignment on newline bug
-        p.y += font->line_height();
-      }
-    }
+  for (auto& positioned : text.glyphs()) {
+    auto glyph = font->glyph(positioned.Code);
+    if (!glyph->bitmap().empty())
+      draw_glyph(origin + positioned.Offset, glyph, color);
   }
 }
 
-void DrawingContext::draw_glyph(const Point& point, const Glyph& glyph,
+void DrawingContext::draw_glyph(const Point& point,
+                                const Shared<Glyph>& glyph,
                                 const Color& color) {
-  auto& graphicsContext = _renderSurface->context();
-  auto& viewport = _renderSurface->GetViewport();
-
-  auto bitmap_scale = glyph.bitmap_size() / glyph.size();
+  auto bitmap_scale = glyph->bitmap_size() / glyph->size();
 
   // todo : fix bitmap offset
   auto bitmap_offset =
-      glyph.bitmap_baseline() * glyph.size() / glyph.bitmap_size();
+      glyph->bitmap_baseline() * glyph->size() / glyph->bitmap_size();
 
   auto p = point;
-  auto off = glyph.bearing() * glm::vec2{1.0f, -1.0f};
+  auto off = glyph->bearing() * glm::vec2{1.0f, -1.0f};
 
 #if XGDI_DRAW_GLYPH_BOUNDING_BOX
-  auto bgrect = Rect{.Offset = p + off, .Size = glyph.size()};
+  auto bgrect = Rect{.Offset = p + off, .Size = glyph->size()};
   draw_rectangle(bgrect, Color::Red);
 #endif
 
-  off.x += glyph.bitmap_baseline().x - off.x;
-  off.y -= glyph.bitmap_baseline().y + off.y;
-  auto rect = Rect{.Offset = p + off, .Size = glyph.size() * bitmap_scale};
+  off.x += glyph->bitmap_baseline().x - off.x;
+  off.y -= glyph->bitmap_baseline().y + off.y;
+  auto rect = Rect{.Offset = p + off, .Size = glyph->size() * bitmap_scale};
+
+  if (!glyph->has_texture())
+    with_render_lock([&] { glyph->create_texture(); });
+
+  auto glyphInfo = _GlyphInfo{.Model = model_projection(rect, next_depth()),
+                              .Color = color};
+
+  enqueue_draw(rect, Rect{}, _GlyphDraw{glyphInfo, glyph});
+}
 
-  auto glyphInfo = _GlyphInfo{.Model = model_projection(rect), .Color = color};
+void DrawingContext::record_draw(const _GlyphDraw& draw) {
+  auto& graphicsContext = _context;
 
   auto uniformBuffer =
-      Shared{new GlyphUniformBuffer(graphicsContext, glyphInfo)};
-  _glyphUniforms.emplace_back(uniformBuffer);
+      Shared{new GlyphUniformBuffer(graphicsContext, draw.Info)};
+  _frameStats.UniformBytes += sizeof(draw.Info);
+  _frameResources->GlyphUniforms.emplace_back(uniformBuffer);
 
-  auto descriptorSet = _descriptorPool->allocate(*_modelInfoSetLayout);
+  auto descriptorSet = allocate_descriptor_set(*_modelInfoSetLayout);
   descriptorSet->update_uniform(0, *uniformBuffer);
-  _transformDescriptorSets.emplace_back(descriptorSet);
+  _frameResources->TransformDescriptorSets.emplace_back(descriptorSet);
 
-  auto samplerSet = _descriptorPool->allocate(*_glyphSetLayout);
-  samplerSet->update_sampler(0, *glyph.texture());
-  _glyphDescriptorSets.emplace_back(samplerSet);
+  auto samplerSet = allocate_descriptor_set(*_glyphSetLayout);
+  samplerSet->update_sampler(0, *draw.Source->texture());
+  _frameResources->GlyphDescriptorSets.emplace_back(samplerSet);
+  _frameResources->Glyphs.emplace_back(draw.Source);
 
   auto descriptorSets =
       std::array<vk::DescriptorSet, 2>{*descriptorSet, *samplerSet};
 
-  for (auto& commandBuffer : _commandBuffers) {
-    commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics,
-                               *_glyphPipeline);
+  bind_pipeline(*_pipelines->Glyph);
+
+  for (auto& commandBuffer : *_recordingBuffers) {
     commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
-                                     *_sampledPipelineLayout, 1, descriptorSets,
-                                     {});
+                                     *_sampledPipelineLayout, 1,
+                                     descriptorSets, {});
 
     commandBuffer.draw(6, 1, 0, 0);
   }
 }
 
 void DrawingContext::draw_bitmap(const Rect& rect, const Bitmap& bitmap) {
-  auto& graphicsContext = _renderSurface->context();
+  if (auto trace = capturing()) trace->record_bitmap(rect, bitmap);
+
+  if (!bitmap.HasTexture())
+    with_render_lock([&] { bitmap.CreateTexture(); });
 
-  auto rectInfo =
-      _RectangleInfo{.Model = model_projection(rect), .Color = Color::White};
+  auto occluder = bitmap.IsOpaque() ? rect : Rect{};
+  auto info =
+      _RectangleInfo{.Model = model_projection(rect, next_depth()),
+                     .Color = Color::White};
+
+  enqueue_draw(rect, occluder, _BitmapDraw{info, bitmap.GetTexture()});
+}
 
-  auto uniformBuffer = Shared{new RectUniformBuffer(graphicsContext, rectInfo)};
-  _rectUniforms.emplace_back(uniformBuffer);
+void DrawingContext::record_draw(const _BitmapDraw& draw) {
+  auto& graphicsContext = _context;
 
-  auto descriptorSet = _descriptorPool->allocate(*_modelInfoSetLayout);
+  auto uniformBuffer =
+      Shared{new RectUniformBuffer(graphicsContext, draw.Info)};
+  _frameStats.UniformBytes += sizeof(draw.Info);
+  _frameResources->RectUniforms.emplace_back(uniformBuffer);
+
+  auto descriptorSet = allocate_descriptor_set(*_modelInfoSetLayout);
   descriptorSet->update_uniform(0, *uniformBuffer);
-  _transformDescriptorSets.emplace_back(descriptorSet);
+  _frameResources->TransformDescriptorSets.emplace_back(descriptorSet);
 
-  auto samplerSet = _descriptorPool->allocate(*_glyphSetLayout);
-  samplerSet->update_sampler(0, *bitmap.GetTexture());
-  _glyphDescriptorSets.emplace_back(samplerSet);
+  auto samplerSet = allocate_descriptor_set(*_glyphSetLayout);
+  samplerSet->update_sampler(0, *draw.Texture);
+  _frameResources->GlyphDescriptorSets.emplace_back(samplerSet);
+  _frameResources->Textures.emplace_back(draw.Texture);
 
   auto descriptorSets =
       std::array<vk::DescriptorSet, 2>{*descriptorSet, *samplerSet};
 
-  for (auto& commandBuffer : _commandBuffers) {
-    commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics,
-                               *_bitmapPipeline);
+  bind_pipeline(*_pipelines->Bitmap);
+
+  for (auto& commandBuffer : *_recordingBuffers) {
     commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
-                                     *_sampledPipelineLayout, 1, descriptorSets,
-                                     {});
+                                     *_sampledPipelineLayout, 1,
+                                     descriptorSets, {});
 
     commandBuffer.draw(6, 1, 0, 0);
   }
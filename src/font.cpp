@@ -3,10 +3,65 @@
 
 #include "muchcool/xgdi/font.hpp"
 
+#include "muchcool/xgdi/frame_stats.hpp"
+
+#include "mapped_file.hpp"
+
+#include <algorithm>
+#include <array>
 #include <exception>
+#include <mutex>
+#include <shared_mutex>
 
 namespace muchcool::xgdi {
 
+constexpr size_t FONT_REGISTRY_SHARDS = 16;
+
+// Kerning pairs cached per font before the cache starts over, and the
+// approximate bytes of one pair counted against the glyph cache budget.
+constexpr size_t MAX_KERNING_PAIRS = 4096;
+constexpr size_t KERNING_PAIR_SIZE = sizeof(uint64) + sizeof(float) +
+                                     2 * sizeof(void*);
+
+struct FontKey {
+  const rndr::GraphicsContext* Context;
+  std::string Path;
+  float Size;
+
+  bool operator==(const FontKey&) const = default;
+};
+
+struct FontKeyHash {
+  size_t operator()(const FontKey& key) const {
+    auto hash = std::hash<const void*>{}(key.Context);
+    hash = hash * 31 + std::hash<std::string>{}(key.Path);
+    hash = hash * 31 + std::hash<float>{}(key.Size);
+    return hash;
+  }
+};
+
+// Fonts are spread over shards by key, so loads of different fonts rarely
+// contend and lookups of cached fonts only take a shared lock.
+struct FontRegistryShard {
+  std::shared_mutex Mutex;
+  std::unordered_map<FontKey, Shared<Font>, FontKeyHash> Fonts;
+};
+
+// Guards the memory counters of all fonts and is never held while loading
+// glyphs.
+std::mutex glyphCacheMutex;
+size_t glyphCacheMemory = 0;
+size_t glyphCacheBudget = 64 * 1024 * 1024;
+
+// Advances with every glyph load. Lookups stamp glyphs with it, so glyphs
+// looked up between two loads count as equally recent.
+std::atomic<uint64> glyphCacheEpoch = 0;
+
+std::mutex fontDataMutex;
+std::unordered_map<std::string, Shared<MappedFile>> fontData;
+
+std::array<FontRegistryShard, FONT_REGISTRY_SHARDS> fontRegistry;
+
 Glyph::Glyph(Shared<rndr::GraphicsContext> context_, ft::Glyph glyph)
     : rndr::GraphicsObject(std::move(context_)),
       _metrics(glyph.metrics()),
@@ -18,61 +73,300 @@ Glyph::Glyph(Shared<rndr::GraphicsContext> context_, ft::Glyph glyph)
   const auto& bitmap = glyph.bitmap();
 
   if (bitmap.width > 0 && bitmap.rows > 0) {
+    _bitmap.assign(bitmap.buffer, bitmap.buffer + bitmap.width * bitmap.rows);
+  }
+}
+
+void Glyph::create_texture() {
+  std::call_once(_textureOnce, [this] {
     _texture = new rndr::Texture(
-        context(), bitmap.width, bitmap.rows, vk::Format::eR8Unorm,
-        bitmap.width * bitmap.rows, bitmap.buffer, vk::Filter::eLinear,
+        context(), static_cast<uint32>(_bitmap_size.x),
+        static_cast<uint32>(_bitmap_size.y), vk::Format::eR8Unorm,
+        _bitmap.size(), _bitmap.data(), vk::Filter::eLinear,
         vk::SamplerAddressMode::eClampToBorder);
-  }
+    ++ResourceCounters::Get().TexturesCreated;
+    _hasTexture.store(true, std::memory_order_release);
+  });
+}
+
+size_t Glyph::memory_size() const {
+  // Without a graphics context the glyph is only used by the CPU rasterizer.
+  return _bitmap.size() * (context() ? 2 : 1);
 }
 
+std::mutex freetypeMutex;
+
 auto& get_freetype() {
   static auto freetype = ft::Library{};
   return freetype;
 }
 
+// FreeType libraries may not create faces on several threads at once.
+ft::Face new_memory_face(const MappedFile& file) {
+  auto lock = std::lock_guard{freetypeMutex};
+  return get_freetype().new_memory_face(file.data(), file.size());
+}
+
+Shared<MappedFile> map_font_file(const fs::path& path) {
+  auto lock = std::lock_guard{fontDataMutex};
+
+  auto& file = fontData[path.string()];
+  if (!file) file = Shared{new MappedFile(path)};
+  return file;
+}
+
 Font::Font(Shared<rndr::GraphicsContext> context_, fs::path fontPath,
-           float size)
+           float size, Shared<MappedFile> fontData)
     : rndr::GraphicsObject(std::move(context_)),
-      _face(get_freetype().new_face(fontPath)),
+      _fontData(std::move(fontData)),
+      _face(new_memory_face(*_fontData)),
       _font(fontPath),
       _size(size) {
   _face.set_char_size(_size);
+  _hasKerning = _face.has_kerning();
 }
 
-const Glyph& Font::glyph(CharCode code) {
+Shared<Glyph> Font::glyph(CharCode code) {
+  {
+    auto lock = std::shared_lock{_mutex};
+    if (auto it = _characterCache.find(code); it != _characterCache.end()) {
+      ++ResourceCounters::Get().GlyphCacheHits;
+      touch(*it->second);
+      return it->second;
+    }
+  }
+
+  auto lock = std::unique_lock{_mutex};
+
+  // Another thread may have loaded the glyph in the meantime.
   if (auto it = _characterCache.find(code); it != _characterCache.end()) {
+    ++ResourceCounters::Get().GlyphCacheHits;
+    touch(*it->second);
     return it->second;
   }
 
+  ++ResourceCounters::Get().GlyphCacheMisses;
+
   const auto glyphIndex = _face.get_char_index(code);
 
   auto glyph = _face.load_glyph(
       glyphIndex, FT_LOAD_RENDER | FT_LOAD_TARGET_(FT_RENDER_MODE_SDF));
 
-  auto pair = _characterCache.try_emplace(code, context(), std::move(glyph));
-  if (!pair.second) {
+  auto cached = Shared{new Glyph(context(), std::move(glyph))};
+  if (!_characterCache.try_emplace(code, cached).second) {
     throw std::runtime_error{"Failed to cache glyph."};
   }
 
-  return pair.first->second;
+  cached->_lastUse = ++glyphCacheEpoch;
+  {
+    auto cacheLock = std::lock_guard{glyphCacheMutex};
+    glyphCacheMemory += cached->memory_size();
+  }
+
+  lock.unlock();
+
+  // The returned reference keeps the new glyph from being evicted.
+  EvictGlyphs();
+
+  return cached;
 }
 
-Font::~Font() {}
+float Font::kerning(CharCode left, CharCode right) {
+  if (!_hasKerning) return 0.0f;
+
+  const auto key = static_cast<uint64>(left) << 32 | static_cast<uint32>(right);
+
+  {
+    auto lock = std::shared_lock{_mutex};
+    if (auto it = _kerningCache.find(key); it != _kerningCache.end()) {
+      return it->second;
+    }
+  }
+
+  // The face is shared with glyph loading.
+  auto lock = std::unique_lock{_mutex};
 
-std::vector<Shared<Font>> fontCache;
+  if (auto it = _kerningCache.find(key); it != _kerningCache.end()) {
+    return it->second;
+  }
+
+  auto delta = _face.get_kerning(_face.get_char_index(left),
+                                 _face.get_char_index(right));
+
+  auto kerning = delta.x / 64.0f;
+
+  auto released = size_t{0};
+  if (_kerningCache.size() >= MAX_KERNING_PAIRS) {
+    released = _kerningCache.size() * KERNING_PAIR_SIZE;
+    _kerningCache.clear();
+  }
+  _kerningCache.emplace(key, kerning);
+
+  auto cacheLock = std::lock_guard{glyphCacheMutex};
+  glyphCacheMemory = glyphCacheMemory + KERNING_PAIR_SIZE - released;
+  return kerning;
+}
+
+Font::~Font() {
+  {
+    // Glyphs still held by frames in flight outlive the font.
+    auto lock = std::lock_guard{glyphCacheMutex};
+    for (auto& [code, glyph] : _characterCache) {
+      glyphCacheMemory -= glyph->memory_size();
+    }
+    glyphCacheMemory -= _kerningCache.size() * KERNING_PAIR_SIZE;
+  }
+
+  // Faces are destroyed under the same lock they are created with, the
+  // moved-from face is empty.
+  auto lock = std::lock_guard{freetypeMutex};
+  auto face = std::move(_face);
+}
+
+void Font::touch(Glyph& glyph) {
+  // Hits on other threads read the same epoch, storing only when it changed
+  // keeps the glyph's cache line shared between them.
+  auto epoch = glyphCacheEpoch.load(std::memory_order_relaxed);
+  if (glyph._lastUse.load(std::memory_order_relaxed) != epoch)
+    glyph._lastUse.store(epoch, std::memory_order_relaxed);
+}
+
+void Font::EvictGlyphs() {
+  {
+    auto lock = std::lock_guard{glyphCacheMutex};
+    if (glyphCacheMemory <= glyphCacheBudget) return;
+  }
+
+  // Dropping whole fonts nobody uses anymore frees the most at once. They
+  // are destroyed outside the shard locks, ~Font takes the cache lock.
+  auto releasedFonts = std::vector<Shared<Font>>();
+  for (auto& shard : fontRegistry) {
+    auto lock = std::unique_lock{shard.Mutex};
+    for (auto it = shard.Fonts.begin(); it != shard.Fonts.end();) {
+      if (it->second.use_count() == 1) {
+        releasedFonts.emplace_back(std::move(it->second));
+        it = shard.Fonts.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  releasedFonts.clear();
+
+  {
+    auto lock = std::lock_guard{fontDataMutex};
+    std::erase_if(fontData, [](const auto& entry) {
+      return entry.second.use_count() == 1;
+    });
+  }
+
+  struct Candidate {
+    uint64 LastUse;
+    Shared<Font> Owner;
+    CharCode Code;
+  };
+
+  // Glyphs are ordered by their stamps once per eviction instead of on every
+  // lookup. Fonts busy on other threads are skipped instead of waited for.
+  auto candidates = std::vector<Candidate>();
+  for (auto& shard : fontRegistry) {
+    auto lock = std::shared_lock{shard.Mutex};
+    for (auto& [key, font] : shard.Fonts) {
+      auto fontLock = std::shared_lock{font->_mutex, std::try_to_lock};
+      if (!fontLock) continue;
+
+      for (auto& [code, glyph] : font->_characterCache) {
+        if (glyph.use_count() > 1) continue;
+        candidates.push_back(Candidate{glyph->_lastUse, font, code});
+      }
+    }
+  }
+
+  std::sort(candidates.begin(), candidates.end(),
+            [](const auto& a, const auto& b) { return a.LastUse < b.LastUse; });
+
+  auto& counters = ResourceCounters::Get();
+
+  // Released after the locks, destroying textures may take a while.
+  auto evicted = std::vector<Shared<Glyph>>();
+
+  for (auto& candidate : candidates) {
+    auto& font = *candidate.Owner;
+
+    // Font::glyph takes the font lock before the cache lock.
+    auto fontLock = std::unique_lock{font._mutex, std::try_to_lock};
+    if (!fontLock) continue;
+
+    auto entry = font._characterCache.find(candidate.Code);
+    if (entry == font._characterCache.end()) continue;
+
+    // Looked up again since, or referenced by a frame in flight or a
+    // recording context.
+    auto& glyph = entry->second;
+    if (glyph->_lastUse != candidate.LastUse || glyph.use_count() > 1)
+      continue;
+
+    auto lock = std::lock_guard{glyphCacheMutex};
+
+    // Evicting down to 7/8 of the budget leaves room for the next loads
+    // before the glyphs have to be sorted again.
+    if (glyphCacheMemory <= glyphCacheBudget - glyphCacheBudget / 8) break;
+
+    glyphCacheMemory -= glyph->memory_size();
+    evicted.emplace_back(std::move(glyph));
+    font._characterCache.erase(entry);
+    ++counters.GlyphEvictions;
+
+    // Kerning pairs are cheap to look up again.
+    glyphCacheMemory -= font._kerningCache.size() * KERNING_PAIR_SIZE;
+    font._kerningCache.clear();
+  }
+
+  // Fonts released from the registry meanwhile are destroyed here, ~Font
+  // takes the cache lock.
+  candidates.clear();
+}
+
+void Font::SetCacheBudget(size_t bytes) {
+  {
+    auto lock = std::lock_guard{glyphCacheMutex};
+    glyphCacheBudget = bytes;
+  }
+  EvictGlyphs();
+}
+
+size_t Font::GetCacheMemory() {
+  auto lock = std::lock_guard{glyphCacheMutex};
+  return glyphCacheMemory;
+}
 
 Shared<Font> Font::Load(Shared<rndr::GraphicsContext> context,
                         fs::path fontPath, float size) {
-  for (auto& font : fontCache) {
-    if (font->context() == context && font->_font == fontPath &&
-        font->_size == size)
-      return font;
+  auto key = FontKey{context.get(), fontPath.string(), size};
+  auto& shard = fontRegistry[FontKeyHash{}(key) % FONT_REGISTRY_SHARDS];
+
+  {
+    auto lock = std::shared_lock{shard.Mutex};
+    if (auto it = shard.Fonts.find(key); it != shard.Fonts.end()) {
+      return it->second;
+    }
   }
 
-  auto font = Shared{new Font(std::move(context), fontPath, size)};
-  fontCache.emplace_back(font);
+  auto lock = std::unique_lock{shard.Mutex};
+
+  // Another thread may have loaded the font in the meantime.
+  auto [it, inserted] = shard.Fonts.try_emplace(std::move(key));
+  if (inserted) {
+    try {
+      it->second = Shared{new Font(std::move(context), fontPath, size,
+                                   map_font_file(fontPath))};
+    } catch (...) {
+      shard.Fonts.erase(it);
+      throw;
+    }
+  }
 
-  return font;
+  return it->second;
 }
 
 }  // namespace muchcool::xgdi
\ No newline at end of file
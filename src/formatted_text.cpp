@@ -3,9 +3,38 @@
 
 #include "muchcool/xgdi/formatted_text.hpp"
 
+#include "utf8.hpp"
+
 namespace muchcool::xgdi {
 
 FormattedText::FormattedText(Shared<Font> font, const char* text)
-    : _font(std::move(font)), _text(text) {}
+    : _font(std::move(font)), _text(text) {
+  auto codes = std::vector<char32_t>();
+  decode_utf8(_text, codes);
+
+  _glyphs.reserve(codes.size());
+
+  auto pen = Point{0.0f, 0.0f};
+  auto previous = char32_t{0};
+
+  for (auto code : codes) {
+    if (code == '\n') {
+      pen = Point{0.0f, pen.y + _font->line_height()};
+      previous = 0;
+      continue;
+    }
+
+    // Other control characters are not drawn.
+    if (code <= 0x1F) continue;
+
+    if (previous) pen.x += _font->kerning(previous, code);
+    previous = code;
+
+    auto glyph = _font->glyph(code);
+    if (!glyph->bitmap().empty()) _glyphs.push_back({code, pen});
+
+    pen.x += glyph->advance();
+  }
+}
 
 }  // namespace muchcool::xgdi
\ No newline at end of file
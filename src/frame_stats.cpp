@@ -0,0 +1,13 @@
+// Copyright (c) 2023 Jacob R. Green
+// All Rights Reserved.
+
+#include "muchcool/xgdi/frame_stats.hpp"
+
+namespace muchcool::xgdi {
+
+ResourceCounters& ResourceCounters::Get() {
+  thread_local auto counters = ResourceCounters{};
+  return counters;
+}
+
+}  // namespace muchcool::xgdi
@@ -0,0 +1,341 @@
+// Copyright (c) 2023 Jacob R. Green
+// All Rights Reserved.
+
+#include "muchcool/xgdi/frame_trace.hpp"
+
+#include "muchcool/xgdi/cpu_drawing_context.hpp"
+#include "muchcool/xgdi/drawing_context.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace muchcool::xgdi {
+
+// "XGTR" in little endian. Values are stored in host byte order.
+constexpr uint32 TRACE_MAGIC = 0x52544758;
+constexpr uint32 TRACE_VERSION = 1;
+
+template <typename T>
+void write(std::vector<uint8>& out, const T& value) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  auto bytes = reinterpret_cast<const uint8*>(&value);
+  out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+void write(std::vector<uint8>& out, std::string_view string) {
+  write(out, static_cast<uint32>(string.size()));
+  out.insert(out.end(), string.begin(), string.end());
+}
+
+void write(std::vector<uint8>& out, const StrokeStyle& style) {
+  write(out, style.Thickness);
+  write(out, static_cast<uint8>(style.Join));
+  write(out, static_cast<uint8>(style.Cap));
+  write(out, style.MiterLimit);
+}
+
+void write(std::vector<uint8>& out, ArrayProxy<const Point> points) {
+  write(out, static_cast<uint32>(points.size()));
+  for (auto& point : points) write(out, point);
+}
+
+class TraceReader {
+  const uint8* _data;
+  size_t _size;
+  size_t _offset = 0;
+
+ public:
+  TraceReader(const uint8* data, size_t size) : _data(data), _size(size) {}
+
+  const uint8* take(size_t size) {
+    if (size > _size - _offset)
+      throw std::runtime_error{"Frame trace is truncated."};
+
+    auto data = _data + _offset;
+    _offset += size;
+    return data;
+  }
+
+  template <typename T>
+  T read() {
+    static_assert(std::is_trivially_copyable_v<T>);
+    T value;
+    std::memcpy(&value, take(sizeof(T)), sizeof(T));
+    return value;
+  }
+
+  std::string read_string() {
+    auto size = read<uint32>();
+    auto data = reinterpret_cast<const char*>(take(size));
+    return std::string(data, size);
+  }
+
+  StrokeStyle read_style() {
+    auto style = StrokeStyle{};
+    style.Thickness = read<float>();
+    style.Join = static_cast<LineJoin>(read<uint8>());
+    style.Cap = static_cast<LineCap>(read<uint8>());
+    style.MiterLimit = read<float>();
+    return style;
+  }
+
+  void read_points(std::vector<Point>& points) {
+    points.resize(read<uint32>());
+    for (auto& point : points) point = read<Point>();
+  }
+};
+
+Shared<FrameTrace> FrameTrace::Load(const fs::path& path) {
+  auto file = std::ifstream(path, std::ios::binary);
+  if (!file) throw std::runtime_error{"Failed to open frame trace."};
+
+  auto bytes = std::vector<uint8>(std::istreambuf_iterator<char>(file), {});
+  auto reader = TraceReader{bytes.data(), bytes.size()};
+
+  if (reader.read<uint32>() != TRACE_MAGIC)
+    throw std::runtime_error{"File is not a frame trace."};
+  if (reader.read<uint32>() != TRACE_VERSION)
+    throw std::runtime_error{"Unsupported frame trace version."};
+
+  auto trace = Shared{new FrameTrace()};
+  trace->_width = reader.read<uint32>();
+  trace->_height = reader.read<uint32>();
+
+  trace->_fonts.resize(reader.read<uint32>());
+  for (auto& font : trace->_fonts) {
+    font.Path = reader.read_string();
+    font.Size = reader.read<float>();
+  }
+
+  trace->_bitmaps.resize(reader.read<uint32>());
+  for (auto& bitmap : trace->_bitmaps) bitmap = reader.read_string();
+
+  trace->_commandCount = reader.read<uint32>();
+  auto commandSize = reader.read<uint64>();
+  auto commands = reader.take(commandSize);
+  trace->_commands.assign(commands, commands + commandSize);
+
+  return trace;
+}
+
+void FrameTrace::save(const fs::path& path) const {
+  auto header = std::vector<uint8>();
+  write(header, TRACE_MAGIC);
+  write(header, TRACE_VERSION);
+  write(header, _width);
+  write(header, _height);
+
+  write(header, static_cast<uint32>(_fonts.size()));
+  for (auto& font : _fonts) {
+    write(header, std::string_view{font.Path});
+    write(header, font.Size);
+  }
+
+  write(header, static_cast<uint32>(_bitmaps.size()));
+  for (auto& bitmap : _bitmaps) write(header, std::string_view{bitmap});
+
+  write(header, _commandCount);
+  write(header, static_cast<uint64>(_commands.size()));
+
+  auto file = std::ofstream(path, std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char*>(header.data()), header.size());
+  file.write(reinterpret_cast<const char*>(_commands.data()),
+             _commands.size());
+  if (!file) throw std::runtime_error{"Failed to write frame trace."};
+}
+
+void FrameTrace::clear(uint32 width, uint32 height) {
+  _width = width;
+  _height = height;
+
+  _fonts.clear();
+  _bitmaps.clear();
+  _commands.clear();
+  _commandCount = 0;
+
+  _fontIndices.clear();
+  _bitmapIndices.clear();
+  _loadedFonts.clear();
+  _loadedBitmaps.clear();
+}
+
+uint32 FrameTrace::font_index(const Shared<Font>& font) {
+  auto [it, inserted] = _fontIndices.try_emplace(
+      font.get(), static_cast<uint32>(_fonts.size()));
+  if (inserted) {
+    _fonts.emplace_back(_TraceFont{font->path().string(), font->size()});
+  }
+  return it->second;
+}
+
+uint32 FrameTrace::bitmap_index(const Bitmap& bitmap) {
+  auto [it, inserted] = _bitmapIndices.try_emplace(
+      &bitmap, static_cast<uint32>(_bitmaps.size()));
+  if (inserted) _bitmaps.emplace_back(bitmap.GetPath());
+  return it->second;
+}
+
+void FrameTrace::record_rectangle(const Rect& rect, const Color& color) {
+  write(_commands, _TraceCommand::Rectangle);
+  write(_commands, rect);
+  write(_commands, color);
+  ++_commandCount;
+}
+
+void FrameTrace::record_rectangle(const Rect& rect, const Size& radius,
+                                  const Color& fill, const Color& stroke,
+                                  float strokeThickness) {
+  write(_commands, _TraceCommand::RoundRect);
+  write(_commands, rect);
+  write(_commands, radius);
+  write(_commands, fill);
+  write(_commands, stroke);
+  write(_commands, strokeThickness);
+  ++_commandCount;
+}
+
+void FrameTrace::record_polyline(ArrayProxy<const Point> points,
+                                 const Color& color,
+                                 const StrokeStyle& style) {
+  write(_commands, _TraceCommand::Polyline);
+  write(_commands, points);
+  write(_commands, color);
+  write(_commands, style);
+  ++_commandCount;
+}
+
+void FrameTrace::record_path(const Path& path, const Color& fill,
+                             const Color& stroke, const StrokeStyle& style) {
+  auto& points = path.points();
+
+  write(_commands, _TraceCommand::Path);
+  write(_commands, static_cast<uint32>(path.sub_paths().size()));
+  for (auto& subPath : path.sub_paths()) {
+    write(_commands, static_cast<uint8>(subPath.Closed));
+    write(_commands, ArrayProxy<const Point>{
+                         subPath.Count, points.data() + subPath.First});
+  }
+  write(_commands, fill);
+  write(_commands, stroke);
+  write(_commands, style);
+  ++_commandCount;
+}
+
+void FrameTrace::record_formatted_text(const Point& point,
+                                       const FormattedText& text,
+                                       const Color& color) {
+  write(_commands, _TraceCommand::Text);
+  write(_commands, point);
+  write(_commands, font_index(text.font()));
+  write(_commands, std::string_view{text.text()});
+  write(_commands, color);
+  ++_commandCount;
+}
+
+void FrameTrace::record_bitmap(const Rect& rect, const Bitmap& bitmap) {
+  write(_commands, _TraceCommand::Bitmap);
+  write(_commands, rect);
+  write(_commands, bitmap_index(bitmap));
+  ++_commandCount;
+}
+
+void FrameTrace::load_resources(Shared<rndr::GraphicsContext> context) {
+  _loadedFonts.clear();
+  for (auto& font : _fonts) {
+    _loadedFonts.emplace_back(Font::Load(context, font.Path, font.Size));
+  }
+
+  _loadedBitmaps.clear();
+  for (auto& bitmap : _bitmaps) {
+    _loadedBitmaps.emplace_back(Shared{new Bitmap(context, bitmap.c_str())});
+  }
+}
+
+void FrameTrace::replay(DrawingContext& context) const {
+  replay_commands(context);
+}
+
+void FrameTrace::replay(CpuDrawingContext& context) const {
+  replay_commands(context);
+}
+
+template <typename Context>
+void FrameTrace::replay_commands(Context& context) const {
+  if (_loadedFonts.size() != _fonts.size() ||
+      _loadedBitmaps.size() != _bitmaps.size())
+    throw std::logic_error{"Frame trace resources are not loaded."};
+
+  auto reader = TraceReader{_commands.data(), _commands.size()};
+  auto points = std::vector<Point>();
+  auto path = Path{};
+
+  for (uint32 i = 0; i < _commandCount; ++i) {
+    switch (reader.read<_TraceCommand>()) {
+      case _TraceCommand::Rectangle: {
+        auto rect = reader.read<Rect>();
+        auto color = reader.read<Color>();
+        context.draw_rectangle(rect, color);
+        break;
+      }
+      case _TraceCommand::RoundRect: {
+        auto rect = reader.read<Rect>();
+        auto radius = reader.read<Size>();
+        auto fill = reader.read<Color>();
+        auto stroke = reader.read<Color>();
+        auto strokeThickness = reader.read<float>();
+        context.draw_rectangle(rect, radius, fill, stroke, strokeThickness);
+        break;
+      }
+      case _TraceCommand::Polyline: {
+        reader.read_points(points);
+        auto color = reader.read<Color>();
+        auto style = reader.read_style();
+
+        context.draw_polyline(points, color, style);
+        break;
+      }
+      case _TraceCommand::Path: {
+        path.clear();
+
+        auto subPathCount = reader.read<uint32>();
+        for (uint32 j = 0; j < subPathCount; ++j) {
+          auto closed = reader.read<uint8>() != 0;
+          reader.read_points(points);
+
+          if (points.empty()) continue;
+
+          path.move_to(points[0]);
+          for (size_t k = 1; k < points.size(); ++k) path.line_to(points[k]);
+          if (closed) path.close();
+        }
+
+        auto fill = reader.read<Color>();
+        auto stroke = reader.read<Color>();
+        auto style = reader.read_style();
+
+        context.draw_path(path, fill, stroke, style);
+        break;
+      }
+      case _TraceCommand::Text: {
+        auto point = reader.read<Point>();
+        auto& font = _loadedFonts.at(reader.read<uint32>());
+        auto text = reader.read_string();
+        auto color = reader.read<Color>();
+        context.draw_formatted_text(point, FormattedText(font, text.c_str()),
+                                    color);
+        break;
+      }
+      case _TraceCommand::Bitmap: {
+        auto rect = reader.read<Rect>();
+        auto& bitmap = _loadedBitmaps.at(reader.read<uint32>());
+        context.draw_bitmap(rect, *bitmap);
+        break;
+      }
+      default:
+        throw std::runtime_error{"Unknown frame trace command."};
+    }
+  }
+}
+
+}  // namespace muchcool::xgdi
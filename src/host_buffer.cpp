@@ -0,0 +1,52 @@
+// Copyright (c) 2023 Jacob R. Green
+// All Rights Reserved.
+
+#include "host_buffer.hpp"
+
+namespace muchcool::xgdi {
+
+uint32 find_memory_type(const rndr::GraphicsContext& context,
+                        uint32 typeBits, vk::MemoryPropertyFlags properties) {
+  auto memoryProperties = context.physical_device().getMemoryProperties();
+
+  for (uint32 i = 0; i < memoryProperties.memoryTypeCount; ++i) {
+    if ((typeBits & (1u << i)) &&
+        (memoryProperties.memoryTypes[i].propertyFlags & properties) ==
+            properties) {
+      return i;
+    }
+  }
+
+  throw std::runtime_error{"Failed to find a suitable memory type."};
+}
+
+HostBuffer::HostBuffer(Shared<rndr::GraphicsContext> context_,
+                       vk::DeviceSize size, vk::BufferUsageFlags usage)
+    : rndr::GraphicsObject(std::move(context_)), _size(size) {
+  auto& device = context()->device();
+
+  _buffer = device.createBuffer(
+      vk::BufferCreateInfo({}, _size, usage, vk::SharingMode::eExclusive));
+
+  auto requirements = device.getBufferMemoryRequirements(_buffer);
+  auto memoryType =
+      find_memory_type(*context(), requirements.memoryTypeBits,
+                       vk::MemoryPropertyFlagBits::eHostVisible |
+                           vk::MemoryPropertyFlagBits::eHostCoherent);
+
+  _memory = device.allocateMemory(
+      vk::MemoryAllocateInfo(requirements.size, memoryType));
+  device.bindBufferMemory(_buffer, _memory, 0);
+
+  _data = device.mapMemory(_memory, 0, _size);
+}
+
+HostBuffer::~HostBuffer() {
+  auto& device = context()->device();
+
+  device.unmapMemory(_memory);
+  device.destroyBuffer(_buffer);
+  device.freeMemory(_memory);
+}
+
+}  // namespace muchcool::xgdi
@@ -0,0 +1,34 @@
+// Copyright (c) 2023 Jacob R. Green
+// All Rights Reserved.
+
+#pragma once
+
+#include <muchcool/rndr.hpp>
+
+namespace muchcool::xgdi {
+
+uint32 find_memory_type(const rndr::GraphicsContext& context,
+                        uint32 typeBits, vk::MemoryPropertyFlags properties);
+
+// Persistently mapped, host coherent buffer for data rewritten by the CPU
+// every frame.
+class HostBuffer : public rndr::GraphicsObject {
+  vk::Buffer _buffer;
+  vk::DeviceMemory _memory;
+  vk::DeviceSize _size;
+  void* _data;
+
+ public:
+  HostBuffer(Shared<rndr::GraphicsContext> context, vk::DeviceSize size,
+             vk::BufferUsageFlags usage);
+  HostBuffer(HostBuffer&&) = delete;
+  HostBuffer(const HostBuffer&) = delete;
+  ~HostBuffer() override;
+
+  auto size() const { return _size; }
+  auto data() const { return _data; }
+
+  operator vk::Buffer() const { return _buffer; }
+};
+
+}  // namespace muchcool::xgdi
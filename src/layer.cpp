@@ -0,0 +1,23 @@
+// Copyright (c) 2023 Jacob R. Green
+// All Rights Reserved.
+
+#include "muchcool/xgdi/layer.hpp"
+
+#include "muchcool/xgdi/drawing_context.hpp"
+#include "render_image.hpp"
+
+namespace muchcool::xgdi {
+
+Layer::Layer(DrawingContext* owner, uint32 width, uint32 height)
+    : _owner(owner), _width(width), _height(height) {
+  _lruEntry = _owner->_layers.insert(_owner->_layers.begin(), this);
+}
+
+Layer::~Layer() {
+  if (!_owner) return;
+
+  if (_image) _owner->_layerMemory -= _image->memory_size();
+  _owner->_layers.erase(_lruEntry);
+}
+
+}  // namespace muchcool::xgdi
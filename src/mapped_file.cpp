@@ -0,0 +1,83 @@
+// Copyright (c) 2023 Jacob R. Green
+// All Rights Reserved.
+
+#include "mapped_file.hpp"
+
+#include <stdexcept>
+
+#ifdef OS_WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace muchcool::xgdi {
+
+#ifdef OS_WINDOWS
+
+MappedFile::MappedFile(const fs::path& path) {
+  _file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (_file == INVALID_HANDLE_VALUE) {
+    _file = nullptr;
+    throw std::runtime_error{"Failed to open file for mapping."};
+  }
+
+  LARGE_INTEGER size;
+  GetFileSizeEx(_file, &size);
+  _size = static_cast<size_t>(size.QuadPart);
+
+  _mapping = CreateFileMappingW(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!_mapping) {
+    CloseHandle(_file);
+    throw std::runtime_error{"Failed to map file."};
+  }
+
+  _data = static_cast<const uint8*>(
+      MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+  if (!_data) {
+    CloseHandle(_mapping);
+    CloseHandle(_file);
+    throw std::runtime_error{"Failed to map file."};
+  }
+}
+
+MappedFile::~MappedFile() {
+  UnmapViewOfFile(_data);
+  CloseHandle(_mapping);
+  CloseHandle(_file);
+}
+
+#else
+
+MappedFile::MappedFile(const fs::path& path) {
+  auto file = open(path.c_str(), O_RDONLY);
+  if (file < 0) throw std::runtime_error{"Failed to open file for mapping."};
+
+  struct stat status;
+  if (fstat(file, &status) != 0) {
+    close(file);
+    throw std::runtime_error{"Failed to map file."};
+  }
+  _size = static_cast<size_t>(status.st_size);
+
+  auto data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, file, 0);
+  // The mapping stays valid after closing the descriptor.
+  close(file);
+
+  if (data == MAP_FAILED) throw std::runtime_error{"Failed to map file."};
+  _data = static_cast<const uint8*>(data);
+}
+
+MappedFile::~MappedFile() {
+  munmap(const_cast<uint8*>(_data), _size);
+}
+
+#endif
+
+}  // namespace muchcool::xgdi
@@ -0,0 +1,30 @@
+// Copyright (c) 2023 Jacob R. Green
+// All Rights Reserved.
+
+#pragma once
+
+#include <muchcool/rndr.hpp>
+
+namespace muchcool::xgdi {
+
+// Read only memory mapping of a whole file.
+class MappedFile final : public Object {
+  const uint8* _data = nullptr;
+  size_t _size = 0;
+
+#ifdef OS_WINDOWS
+  void* _file = nullptr;
+  void* _mapping = nullptr;
+#endif
+
+ public:
+  explicit MappedFile(const fs::path& path);
+  MappedFile(MappedFile&&) = delete;
+  MappedFile(const MappedFile&) = delete;
+  ~MappedFile() override;
+
+  auto data() const { return _data; }
+  auto size() const { return _size; }
+};
+
+}  // namespace muchcool::xgdi
@@ -0,0 +1,99 @@
+// Copyright (c) 2023 Jacob R. Green
+// All Rights Reserved.
+
+#include "muchcool/xgdi/offscreen_target.hpp"
+
+#include "host_buffer.hpp"
+#include "render_image.hpp"
+
+#include <cstring>
+
+namespace muchcool::xgdi {
+
+OffscreenTarget::OffscreenTarget(Shared<rndr::GraphicsContext> context_,
+                                 uint32 width, uint32 height)
+    : rndr::GraphicsObject(std::move(context_)) {
+  auto& device = context()->device();
+
+  _renderPass = create_offscreen_render_pass(
+      context(), Format, vk::ImageLayout::eTransferSrcOptimal);
+
+  _image = new RenderImage(context(), *_renderPass, width, height, Format,
+                           vk::ImageUsageFlagBits::eTransferSrc);
+
+  _readbackBuffer =
+      new HostBuffer(context(), vk::DeviceSize(width) * height * 4,
+                     vk::BufferUsageFlagBits::eTransferDst);
+
+  _fence = device.createFence(
+      vk::FenceCreateInfo(vk::FenceCreateFlagBits::eSignaled));
+}
+
+OffscreenTarget::~OffscreenTarget() {
+  auto& device = context()->device();
+
+  // A destructor has no way to report a lost device, destroy the fence
+  // regardless.
+  (void)device.waitForFences(_fence, VK_TRUE, UINT64_MAX);
+  device.destroyFence(_fence);
+}
+
+uint32 OffscreenTarget::width() const { return _image->width(); }
+
+uint32 OffscreenTarget::height() const { return _image->height(); }
+
+vk::Extent2D OffscreenTarget::extent() const { return _image->extent(); }
+
+vk::Viewport OffscreenTarget::viewport() const {
+  return vk::Viewport(0.0f, 0.0f, static_cast<float>(width()),
+                      static_cast<float>(height()), 0.0f, 1.0f);
+}
+
+vk::Rect2D OffscreenTarget::scissor() const {
+  return vk::Rect2D({0, 0}, extent());
+}
+
+vk::Framebuffer OffscreenTarget::framebuffer() const {
+  return _image->framebuffer();
+}
+
+void OffscreenTarget::record_readback(vk::CommandBuffer& commandBuffer) const {
+  auto region = vk::BufferImageCopy(
+      0, 0, 0,
+      vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1),
+      {0, 0, 0}, vk::Extent3D(extent(), 1));
+
+  commandBuffer.copyImageToBuffer(_image->image(),
+                                  vk::ImageLayout::eTransferSrcOptimal,
+                                  *_readbackBuffer, region);
+
+  auto barrier = vk::BufferMemoryBarrier(
+      vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eHostRead,
+      VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, *_readbackBuffer, 0,
+      VK_WHOLE_SIZE);
+
+  commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                vk::PipelineStageFlagBits::eHost, {}, {},
+                                barrier, {});
+}
+
+std::future<void> OffscreenTarget::read_pixels(ArrayProxy<uint8> pixels) const {
+  const auto size = static_cast<size_t>(_readbackBuffer->size());
+  if (pixels.size() < size) {
+    throw std::invalid_argument{"Pixel buffer is too small for the target."};
+  }
+
+  auto* destination = pixels.data();
+
+  return std::async(std::launch::async, [this, destination, size] {
+    auto& device = context()->device();
+
+    auto result = device.waitForFences(_fence, VK_TRUE, UINT64_MAX);
+    if (result != vk::Result::eSuccess)
+      vk::throwResultException(result, "failed to wait for fence.");
+
+    std::memcpy(destination, _readbackBuffer->data(), size);
+  });
+}
+
+}  // namespace muchcool::xgdi
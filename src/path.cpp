@@ -0,0 +1,36 @@
+// Copyright (c) 2023 Jacob R. Green
+// All Rights Reserved.
+
+#include "muchcool/xgdi/path.hpp"
+
+namespace muchcool::xgdi {
+
+Path& Path::move_to(const Point& point) {
+  _subPaths.emplace_back(SubPath{.First = static_cast<uint32>(_points.size()),
+                                 .Count = 1,
+                                 .Closed = false});
+  _points.emplace_back(point);
+  return *this;
+}
+
+Path& Path::line_to(const Point& point) {
+  if (_subPaths.empty() || _subPaths.back().Closed) {
+    return move_to(point);
+  }
+
+  _points.emplace_back(point);
+  ++_subPaths.back().Count;
+  return *this;
+}
+
+Path& Path::close() {
+  if (!_subPaths.empty()) _subPaths.back().Closed = true;
+  return *this;
+}
+
+void Path::clear() {
+  _points.clear();
+  _subPaths.clear();
+}
+
+}  // namespace muchcool::xgdi
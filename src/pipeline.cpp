@@ -0,0 +1,86 @@
+// Copyright (c) 2023 Jacob R. Green
+// All Rights Reserved.
+
+#include "pipeline.hpp"
+
+#include <array>
+#include <cstring>
+
+namespace muchcool::xgdi {
+
+Pipeline::Pipeline(
+    Shared<rndr::GraphicsContext> context_,
+    const rndr::RenderPass& renderPass, const rndr::PipelineLayout& layout,
+    ArrayProxy<const uint8> vertexShaderData,
+    ArrayProxy<const uint8> fragmentShaderData,
+    const vk::PipelineColorBlendAttachmentState& blendState,
+    const vk::PipelineDepthStencilStateCreateInfo& depthState,
+    ArrayProxy<const vk::VertexInputBindingDescription> vertexBindings,
+    ArrayProxy<const vk::VertexInputAttributeDescription> vertexAttributes)
+    : rndr::GraphicsObject(std::move(context_)) {
+  auto& device = context()->device();
+
+  auto createShaderModule = [&](ArrayProxy<const uint8> code) {
+    // The embedded SPIR-V is a byte array, modules take aligned words.
+    auto words = std::vector<uint32>((code.size() + 3) / 4);
+    std::memcpy(words.data(), code.data(), code.size());
+
+    return device.createShaderModule(
+        vk::ShaderModuleCreateInfo({}, code.size(), words.data()));
+  };
+
+  auto vertexShader = createShaderModule(vertexShaderData);
+  auto fragmentShader = createShaderModule(fragmentShaderData);
+
+  auto stages = std::array{
+      vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eVertex,
+                                        vertexShader, "main"),
+      vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eFragment,
+                                        fragmentShader, "main")};
+
+  auto vertexInput = vk::PipelineVertexInputStateCreateInfo(
+      {}, vertexBindings.size(), vertexBindings.data(),
+      vertexAttributes.size(), vertexAttributes.data());
+
+  auto inputAssembly = vk::PipelineInputAssemblyStateCreateInfo(
+      {}, vk::PrimitiveTopology::eTriangleList);
+
+  // Viewport and scissor are set per render pass, layers differ in size.
+  auto viewportState =
+      vk::PipelineViewportStateCreateInfo({}, 1, nullptr, 1, nullptr);
+
+  auto rasterization = vk::PipelineRasterizationStateCreateInfo(
+      {}, VK_FALSE, VK_FALSE, vk::PolygonMode::eFill,
+      vk::CullModeFlagBits::eNone, vk::FrontFace::eCounterClockwise, VK_FALSE,
+      0.0f, 0.0f, 0.0f, 1.0f);
+
+  auto multisample = vk::PipelineMultisampleStateCreateInfo(
+      {}, vk::SampleCountFlagBits::e1);
+
+  auto colorBlend = vk::PipelineColorBlendStateCreateInfo(
+      {}, VK_FALSE, vk::LogicOp::eCopy, 1, &blendState);
+
+  auto dynamicStates =
+      std::array{vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+  auto dynamicState = vk::PipelineDynamicStateCreateInfo(
+      {}, static_cast<uint32>(dynamicStates.size()), dynamicStates.data());
+
+  auto createInfo = vk::GraphicsPipelineCreateInfo(
+      {}, static_cast<uint32>(stages.size()), stages.data(), &vertexInput,
+      &inputAssembly, nullptr, &viewportState, &rasterization, &multisample,
+      &depthState, &colorBlend, &dynamicState, layout, renderPass, 0);
+
+  auto result = device.createGraphicsPipeline(nullptr, createInfo);
+
+  device.destroyShaderModule(vertexShader);
+  device.destroyShaderModule(fragmentShader);
+
+  if (result.result != vk::Result::eSuccess)
+    vk::throwResultException(result.result, "failed to create pipeline.");
+
+  _pipeline = result.value;
+}
+
+Pipeline::~Pipeline() { context()->device().destroyPipeline(_pipeline); }
+
+}  // namespace muchcool::xgdi
@@ -0,0 +1,35 @@
+// Copyright (c) 2023 Jacob R. Green
+// All Rights Reserved.
+
+#pragma once
+
+#include <muchcool/rndr.hpp>
+
+namespace muchcool::xgdi {
+
+// Graphics pipeline drawing triangle lists with dynamic viewport and scissor
+// into a single color attachment and an optional depth attachment. Created
+// with Vulkan directly, so blending and depth testing can be chosen per
+// pipeline.
+class Pipeline : public rndr::GraphicsObject {
+  vk::Pipeline _pipeline;
+
+ public:
+  Pipeline(Shared<rndr::GraphicsContext> context,
+           const rndr::RenderPass& renderPass,
+           const rndr::PipelineLayout& layout,
+           ArrayProxy<const uint8> vertexShaderData,
+           ArrayProxy<const uint8> fragmentShaderData,
+           const vk::PipelineColorBlendAttachmentState& blendState,
+           const vk::PipelineDepthStencilStateCreateInfo& depthState,
+           ArrayProxy<const vk::VertexInputBindingDescription> vertexBindings,
+           ArrayProxy<const vk::VertexInputAttributeDescription>
+               vertexAttributes);
+  Pipeline(Pipeline&&) = delete;
+  Pipeline(const Pipeline&) = delete;
+  ~Pipeline() override;
+
+  operator vk::Pipeline() const { return _pipeline; }
+};
+
+}  // namespace muchcool::xgdi
@@ -0,0 +1,101 @@
+// Copyright (c) 2023 Jacob R. Green
+// All Rights Reserved.
+
+#include "presenter.hpp"
+
+#include <utility>
+
+namespace muchcool::xgdi {
+
+Presenter::Presenter(SubmitMode mode, PresentFunction present)
+    : _mode(mode), _present(std::move(present)) {
+  _thread = std::thread([this] { run(); });
+}
+
+Presenter::~Presenter() {
+  _stopping.store(true, std::memory_order_release);
+  _pushed.fetch_add(1, std::memory_order_release);
+  _pushed.notify_one();
+
+  _thread.join();
+}
+
+uint32 Presenter::acquire_slot() {
+  while (true) {
+    rethrow_error();
+
+    auto released = _released.load(std::memory_order_acquire);
+
+    for (uint32 slot = 0; slot < SlotCount; ++slot) {
+      if (!_busy[slot].exchange(true, std::memory_order_acq_rel)) return slot;
+    }
+
+    _released.wait(released, std::memory_order_acquire);
+  }
+}
+
+void Presenter::push(uint32 slot) {
+  rethrow_error();
+
+  if (_mode == SubmitMode::Mailbox) {
+    auto dropped = _mailbox.exchange(slot, std::memory_order_acq_rel);
+    if (dropped != NoSlot) release(dropped);
+  } else {
+    // Never full, at most SlotCount frames are in flight.
+    _queue.try_push(slot);
+  }
+
+  _pushed.fetch_add(1, std::memory_order_release);
+  _pushed.notify_one();
+}
+
+void Presenter::run() {
+  while (true) {
+    auto pushed = _pushed.load(std::memory_order_acquire);
+
+    auto slot = NoSlot;
+    if (try_pop(slot)) {
+      try {
+        _present(slot);
+      } catch (...) {
+        auto lock = std::lock_guard{_errorMutex};
+        if (!_error) _error = std::current_exception();
+        _failed.store(true, std::memory_order_release);
+      }
+
+      release(slot);
+      continue;
+    }
+
+    if (_stopping.load(std::memory_order_acquire)) return;
+
+    _pushed.wait(pushed, std::memory_order_acquire);
+  }
+}
+
+bool Presenter::try_pop(uint32& slot) {
+  if (_mode == SubmitMode::Mailbox) {
+    slot = _mailbox.exchange(NoSlot, std::memory_order_acq_rel);
+    return slot != NoSlot;
+  }
+
+  return _queue.try_pop(slot);
+}
+
+void Presenter::release(uint32 slot) {
+  _busy[slot].store(false, std::memory_order_release);
+  _released.fetch_add(1, std::memory_order_release);
+  _released.notify_all();
+}
+
+void Presenter::rethrow_error() {
+  if (!_failed.load(std::memory_order_acquire)) return;
+
+  auto lock = std::lock_guard{_errorMutex};
+  _failed.store(false, std::memory_order_relaxed);
+  if (auto error = std::exchange(_error, nullptr)) {
+    std::rethrow_exception(error);
+  }
+}
+
+}  // namespace muchcool::xgdi
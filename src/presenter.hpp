@@ -0,0 +1,74 @@
+// Copyright (c) 2023 Jacob R. Green
+// All Rights Reserved.
+
+#pragma once
+
+#include "muchcool/xgdi/drawing_context.hpp"
+#include "spsc_queue.hpp"
+
+#include <array>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace muchcool::xgdi {
+
+// Presents frames on a dedicated thread. Each frame lives in one of a fixed
+// number of slots: the recording thread fills a free slot and pushes it, the
+// presenter thread presents it and releases the slot once the GPU is done.
+// Slots are handed over without locks.
+class Presenter final : public Object {
+ public:
+  using PresentFunction = std::function<void(uint32 slot)>;
+
+  // One slot recording, one queued and one presenting.
+  static constexpr uint32 SlotCount = 3;
+
+ private:
+  static constexpr uint32 NoSlot = UINT32_MAX;
+
+  SubmitMode _mode;
+  PresentFunction _present;
+
+  SpscQueue<uint32, 4> _queue;
+  std::atomic<uint32> _mailbox = NoSlot;
+
+  std::array<std::atomic<bool>, SlotCount> _busy = {};
+  std::atomic<uint64> _pushed = 0;
+  std::atomic<uint64> _released = 0;
+  std::atomic<bool> _stopping = false;
+
+  std::atomic<bool> _failed = false;
+  std::mutex _errorMutex;
+  std::exception_ptr _error;
+
+  std::thread _thread;
+
+ public:
+  Presenter(SubmitMode mode, PresentFunction present);
+  Presenter(Presenter&&) = delete;
+  Presenter(const Presenter&) = delete;
+  // Presents the frames still queued before joining the thread.
+  ~Presenter() override;
+
+  // Returns a slot no frame uses anymore. In queued mode this waits while
+  // all slots are in flight.
+  uint32 acquire_slot();
+
+  // Hands a recorded slot to the presenter thread. In mailbox mode a frame
+  // still waiting to be presented is dropped and its slot released.
+  void push(uint32 slot);
+
+ private:
+  void run();
+  bool try_pop(uint32& slot);
+  void release(uint32 slot);
+
+  // Rethrows an exception the presenter thread ran into, on the recording
+  // thread.
+  void rethrow_error();
+};
+
+}  // namespace muchcool::xgdi
@@ -0,0 +1,142 @@
+// Copyright (c) 2023 Jacob R. Green
+// All Rights Reserved.
+
+#include "render_image.hpp"
+
+#include "host_buffer.hpp"
+
+namespace muchcool::xgdi {
+
+vk::Format find_depth_format(const rndr::GraphicsContext& context) {
+  auto properties =
+      context.physical_device().getFormatProperties(vk::Format::eD32Sfloat);
+
+  if (properties.optimalTilingFeatures &
+      vk::FormatFeatureFlagBits::eDepthStencilAttachment) {
+    return vk::Format::eD32Sfloat;
+  }
+  return vk::Format::eX8D24UnormPack32;
+}
+
+Shared<rndr::RenderPass> create_offscreen_render_pass(
+    Shared<rndr::GraphicsContext> context, vk::Format format,
+    vk::ImageLayout finalLayout) {
+  auto attachments = std::array{
+      vk::AttachmentDescription(
+          {}, format, vk::SampleCountFlagBits::e1,
+          vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eStore,
+          vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eDontCare,
+          vk::ImageLayout::eUndefined, finalLayout),
+      vk::AttachmentDescription(
+          {}, find_depth_format(*context), vk::SampleCountFlagBits::e1,
+          vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eDontCare,
+          vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eDontCare,
+          vk::ImageLayout::eUndefined,
+          vk::ImageLayout::eDepthStencilAttachmentOptimal)};
+
+  auto colorReference =
+      vk::AttachmentReference(0, vk::ImageLayout::eColorAttachmentOptimal);
+  auto depthReference = vk::AttachmentReference(
+      1, vk::ImageLayout::eDepthStencilAttachmentOptimal);
+
+  auto subpass =
+      vk::SubpassDescription({}, vk::PipelineBindPoint::eGraphics, {},
+                             colorReference, {}, &depthReference);
+
+  // The depth image is reused by every frame, clearing it waits for the
+  // depth writes of the previous one. Make the results visible to whoever
+  // reads the image after the pass, the bitmap pipeline for layers and
+  // transfers for readback.
+  auto dependencies = std::array{
+      vk::SubpassDependency(
+          VK_SUBPASS_EXTERNAL, 0,
+          vk::PipelineStageFlagBits::eColorAttachmentOutput |
+              vk::PipelineStageFlagBits::eLateFragmentTests,
+          vk::PipelineStageFlagBits::eColorAttachmentOutput |
+              vk::PipelineStageFlagBits::eEarlyFragmentTests,
+          vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+          vk::AccessFlagBits::eColorAttachmentWrite |
+              vk::AccessFlagBits::eDepthStencilAttachmentWrite),
+      vk::SubpassDependency(0, VK_SUBPASS_EXTERNAL,
+                            vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                            vk::PipelineStageFlagBits::eFragmentShader |
+                                vk::PipelineStageFlagBits::eTransfer,
+                            vk::AccessFlagBits::eColorAttachmentWrite,
+                            vk::AccessFlagBits::eShaderRead |
+                                vk::AccessFlagBits::eTransferRead)};
+
+  auto createInfo =
+      vk::RenderPassCreateInfo({}, attachments, subpass, dependencies);
+
+  return Shared{new rndr::RenderPass(std::move(context), createInfo)};
+}
+
+RenderImage::RenderImage(Shared<rndr::GraphicsContext> context_,
+                         const rndr::RenderPass& renderPass, uint32 width,
+                         uint32 height, vk::Format format,
+                         vk::ImageUsageFlags usage)
+    : rndr::GraphicsObject(std::move(context_)),
+      _width(width),
+      _height(height) {
+  auto& device = context()->device();
+
+  _image = device.createImage(vk::ImageCreateInfo(
+      {}, vk::ImageType::e2D, format, vk::Extent3D(_width, _height, 1), 1, 1,
+      vk::SampleCountFlagBits::e1, vk::ImageTiling::eOptimal,
+      usage | vk::ImageUsageFlagBits::eColorAttachment,
+      vk::SharingMode::eExclusive, {}, vk::ImageLayout::eUndefined));
+
+  auto requirements = device.getImageMemoryRequirements(_image);
+  auto memoryType =
+      find_memory_type(*context(), requirements.memoryTypeBits,
+                       vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+  _memorySize = requirements.size;
+  _memory = device.allocateMemory(
+      vk::MemoryAllocateInfo(requirements.size, memoryType));
+  device.bindImageMemory(_image, _memory, 0);
+
+  _view = device.createImageView(vk::ImageViewCreateInfo(
+      {}, _image, vk::ImageViewType::e2D, format, {},
+      vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1)));
+
+  const auto depthFormat = find_depth_format(*context());
+
+  _depthImage = device.createImage(vk::ImageCreateInfo(
+      {}, vk::ImageType::e2D, depthFormat, vk::Extent3D(_width, _height, 1), 1,
+      1, vk::SampleCountFlagBits::e1, vk::ImageTiling::eOptimal,
+      vk::ImageUsageFlagBits::eDepthStencilAttachment,
+      vk::SharingMode::eExclusive, {}, vk::ImageLayout::eUndefined));
+
+  auto depthRequirements = device.getImageMemoryRequirements(_depthImage);
+  auto depthMemoryType =
+      find_memory_type(*context(), depthRequirements.memoryTypeBits,
+                       vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+  _memorySize += depthRequirements.size;
+  _depthMemory = device.allocateMemory(
+      vk::MemoryAllocateInfo(depthRequirements.size, depthMemoryType));
+  device.bindImageMemory(_depthImage, _depthMemory, 0);
+
+  _depthView = device.createImageView(vk::ImageViewCreateInfo(
+      {}, _depthImage, vk::ImageViewType::e2D, depthFormat, {},
+      vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1)));
+
+  auto attachments = std::array{_view, _depthView};
+  _framebuffer = device.createFramebuffer(vk::FramebufferCreateInfo(
+      {}, renderPass, attachments, _width, _height, 1));
+}
+
+RenderImage::~RenderImage() {
+  auto& device = context()->device();
+
+  device.destroyFramebuffer(_framebuffer);
+  device.destroyImageView(_depthView);
+  device.destroyImage(_depthImage);
+  device.freeMemory(_depthMemory);
+  device.destroyImageView(_view);
+  device.destroyImage(_image);
+  device.freeMemory(_memory);
+}
+
+}  // namespace muchcool::xgdi
@@ -0,0 +1,57 @@
+// Copyright (c) 2023 Jacob R. Green
+// All Rights Reserved.
+
+#pragma once
+
+#include <muchcool/rndr.hpp>
+
+namespace muchcool::xgdi {
+
+// Depth format of offscreen render passes, 32 bit float if supported and 24
+// bit otherwise, one of which every device supports.
+vk::Format find_depth_format(const rndr::GraphicsContext& context);
+
+// Creates a single subpass render pass with a color and a depth attachment.
+// Both are cleared, the color attachment is left in `finalLayout`, depth is
+// discarded.
+Shared<rndr::RenderPass> create_offscreen_render_pass(
+    Shared<rndr::GraphicsContext> context, vk::Format format,
+    vk::ImageLayout finalLayout);
+
+// Device local color and depth images with a framebuffer for a render pass
+// from create_offscreen_render_pass, used as an offscreen render target.
+class RenderImage : public rndr::GraphicsObject {
+  uint32 _width;
+  uint32 _height;
+
+  vk::Image _image;
+  vk::DeviceMemory _memory;
+  vk::DeviceSize _memorySize;
+  vk::ImageView _view;
+
+  vk::Image _depthImage;
+  vk::DeviceMemory _depthMemory;
+  vk::ImageView _depthView;
+
+  vk::Framebuffer _framebuffer;
+
+ public:
+  RenderImage(Shared<rndr::GraphicsContext> context,
+              const rndr::RenderPass& renderPass, uint32 width, uint32 height,
+              vk::Format format, vk::ImageUsageFlags usage);
+  RenderImage(RenderImage&&) = delete;
+  RenderImage(const RenderImage&) = delete;
+  ~RenderImage() override;
+
+  auto width() const { return _width; }
+  auto height() const { return _height; }
+  auto extent() const { return vk::Extent2D(_width, _height); }
+
+  auto image() const { return _image; }
+  auto view() const { return _view; }
+  auto framebuffer() const { return _framebuffer; }
+  // Bytes held by the color and depth images.
+  auto memory_size() const { return _memorySize; }
+};
+
+}  // namespace muchcool::xgdi
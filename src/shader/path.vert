@@ -0,0 +1,18 @@
+#version 450
+
+layout (set = 0, binding = 0) uniform RenderInfo {
+    mat4 Projection;
+} renderInfo;
+
+layout(location = 0) in vec3 in_position;
+layout(location = 1) in vec4 in_color;
+
+layout(location = 0) out vec4 fragColor;
+
+
+// Pre-tessellated triangle lists, positions are already in view space and
+// carry the negated depth of the draw in z.
+void main() {
+    fragColor = in_color;
+    gl_Position = renderInfo.Projection * vec4(in_position, 1.0f);
+}
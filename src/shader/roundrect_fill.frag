@@ -0,0 +1,34 @@
+#version 450
+
+layout (set = 1, binding = 0) uniform ModelInfo {
+    mat4 Model;
+    vec4 FillColor;
+    vec4 StrokeColor;
+    vec2 Size;
+    vec2 Radius;
+    float StrokeWidth;
+} modelInfo;
+
+layout(location = 0) in vec2 inRectPos;
+
+layout(location = 0) out vec4 outColor;
+
+#define epsilon float(1e-37)
+
+float sdfRoundedRectangle(vec2 pos, vec2 size, vec2 _radius){
+    float radius = _radius.x;
+    return length(max(abs(pos) - size + radius, 0.0)) - radius;
+}
+
+
+// Fill-only variant of roundrect.frag, selected when StrokeWidth is 0 so only
+// a single distance has to be evaluated per fragment.
+void main() {
+    vec2 halfSize = (modelInfo.Size / 2);
+    vec2 rectPos = inRectPos - halfSize;
+
+    float fillDistance = sdfRoundedRectangle(rectPos, halfSize, modelInfo.Radius);
+    float fillAlpha = 1 - step(epsilon, fillDistance);
+
+    outColor = modelInfo.FillColor * fillAlpha;
+}
@@ -0,0 +1,46 @@
+// Copyright (c) 2023 Jacob R. Green
+// All Rights Reserved.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace muchcool::xgdi {
+
+// Lock-free bounded queue for exactly one producer and one consumer thread.
+template <typename T, size_t Capacity>
+class SpscQueue {
+  static_assert((Capacity & (Capacity - 1)) == 0,
+                "Capacity must be a power of two.");
+
+  std::array<T, Capacity> _items;
+
+  // Kept on separate cache lines, each is written by one side only.
+  alignas(64) std::atomic<size_t> _head = 0;
+  alignas(64) std::atomic<size_t> _tail = 0;
+
+ public:
+  // Called by the producer, returns false if the queue is full.
+  bool try_push(const T& item) {
+    auto tail = _tail.load(std::memory_order_relaxed);
+    if (tail - _head.load(std::memory_order_acquire) == Capacity) return false;
+
+    _items[tail & (Capacity - 1)] = item;
+    _tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Called by the consumer, returns false if the queue is empty.
+  bool try_pop(T& item) {
+    auto head = _head.load(std::memory_order_relaxed);
+    if (head == _tail.load(std::memory_order_acquire)) return false;
+
+    item = _items[head & (Capacity - 1)];
+    _head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+};
+
+}  // namespace muchcool::xgdi
@@ -0,0 +1,208 @@
+// Copyright (c) 2023 Jacob R. Green
+// All Rights Reserved.
+
+#include "tessellator.hpp"
+
+#include <cmath>
+#include <numbers>
+
+namespace muchcool::xgdi {
+
+// Maximum distance in pixels between a round join / cap and its polygon.
+constexpr auto RoundTolerance = 0.25f;
+
+constexpr auto DuplicateEpsilon = 1e-4f;
+
+// Per segment unit directions, stored as separate arrays so the
+// normalization loop is vectorized by the compiler.
+struct Segments {
+  std::vector<float> dx;
+  std::vector<float> dy;
+
+  void compute(const std::vector<Point>& points, bool closed);
+
+  auto size() const { return dx.size(); }
+  Point direction(size_t i) const { return {dx[i], dy[i]}; }
+  Point normal(size_t i) const { return {-dy[i], dx[i]}; }
+};
+
+void Segments::compute(const std::vector<Point>& points, bool closed) {
+  const auto count = points.size();
+  const auto segments = closed ? count : count - 1;
+
+  dx.resize(segments);
+  dy.resize(segments);
+
+  auto* __restrict x = dx.data();
+  auto* __restrict y = dy.data();
+  const auto* p = points.data();
+
+  for (size_t i = 0; i < count - 1; ++i) {
+    x[i] = p[i + 1].x - p[i].x;
+    y[i] = p[i + 1].y - p[i].y;
+  }
+
+  if (closed) {
+    x[count - 1] = p[0].x - p[count - 1].x;
+    y[count - 1] = p[0].y - p[count - 1].y;
+  }
+
+  for (size_t i = 0; i < segments; ++i) {
+    const auto inverse = 1.0f / std::sqrt(x[i] * x[i] + y[i] * y[i]);
+    x[i] *= inverse;
+    y[i] *= inverse;
+  }
+}
+
+static float cross(const Point& a, const Point& b) {
+  return a.x * b.y - a.y * b.x;
+}
+
+static void append_triangle(std::vector<Point>& out, const Point& a,
+                            const Point& b, const Point& c) {
+  out.emplace_back(a);
+  out.emplace_back(b);
+  out.emplace_back(c);
+}
+
+// Appends a fan around `center`, sweeping the offset `from` by `angle`.
+static void append_arc(std::vector<Point>& out, const Point& center,
+                       Point from, float angle, float radius) {
+  const auto maxStep =
+      radius > RoundTolerance
+          ? 2.0f * std::acos(1.0f - RoundTolerance / radius)
+          : std::numbers::pi_v<float>;
+
+  const auto steps =
+      std::max(1, static_cast<int>(std::ceil(std::abs(angle) / maxStep)));
+  const auto delta = angle / static_cast<float>(steps);
+  const auto c = std::cos(delta);
+  const auto s = std::sin(delta);
+
+  for (int i = 0; i < steps; ++i) {
+    const auto to = Point{from.x * c - from.y * s, from.x * s + from.y * c};
+    append_triangle(out, center, center + from, center + to);
+    from = to;
+  }
+}
+
+static void append_join(std::vector<Point>& out, const Point& point,
+                        const Point& d0, const Point& d1,
+                        const StrokeStyle& style, float halfWidth) {
+  const auto turn = cross(d0, d1);
+  if (std::abs(turn) < DuplicateEpsilon && glm::dot(d0, d1) > 0.0f) return;
+
+  // Joins only have to fill the gap on the outer side of the turn.
+  const auto side = turn > 0.0f ? -1.0f : 1.0f;
+  const auto n0 = Point{-d0.y, d0.x} * side;
+  const auto n1 = Point{-d1.y, d1.x} * side;
+  const auto a = n0 * halfWidth;
+  const auto b = n1 * halfWidth;
+
+  switch (style.Join) {
+    case LineJoin::Round:
+      append_arc(out, point, a, std::atan2(cross(a, b), glm::dot(a, b)),
+                 halfWidth);
+      return;
+
+    case LineJoin::Miter: {
+      const auto bisector = n0 + n1;
+      const auto length = glm::length(bisector);
+      if (length > DuplicateEpsilon) {
+        const auto miter = bisector / length;
+        const auto cosine = glm::dot(miter, n0);
+        if (1.0f / cosine <= style.MiterLimit) {
+          const auto tip = point + miter * (halfWidth / cosine);
+          append_triangle(out, point, point + a, tip);
+          append_triangle(out, point, tip, point + b);
+          return;
+        }
+      }
+      [[fallthrough]];
+    }
+
+    case LineJoin::Bevel:
+      append_triangle(out, point, point + a, point + b);
+      return;
+  }
+}
+
+void tessellate_stroke(ArrayProxy<const Point> points_, bool closed,
+                       const StrokeStyle& style, std::vector<Point>& out) {
+  thread_local auto points = std::vector<Point>{};
+  thread_local auto segments = Segments{};
+
+  points.clear();
+  for (auto& point : points_) {
+    if (points.empty() ||
+        glm::length(point - points.back()) > DuplicateEpsilon) {
+      points.emplace_back(point);
+    }
+  }
+
+  if (closed && points.size() > 2 &&
+      glm::length(points.front() - points.back()) <= DuplicateEpsilon) {
+    points.pop_back();
+  }
+
+  if (points.size() < 2 || style.Thickness <= 0.0f) return;
+  closed &= points.size() > 2;
+
+  segments.compute(points, closed);
+
+  const auto halfWidth = style.Thickness / 2.0f;
+  const auto count = points.size();
+  const auto segmentCount = segments.size();
+
+  if (!closed) {
+    const auto first = segments.direction(0);
+    const auto last = segments.direction(segmentCount - 1);
+
+    switch (style.Cap) {
+      case LineCap::Butt:
+        break;
+
+      case LineCap::Square:
+        points.front() -= first * halfWidth;
+        points.back() += last * halfWidth;
+        break;
+
+      case LineCap::Round:
+        append_arc(out, points.front(), segments.normal(0) * halfWidth,
+                   std::numbers::pi_v<float>, halfWidth);
+        append_arc(out, points.back(),
+                   -segments.normal(segmentCount - 1) * halfWidth,
+                   std::numbers::pi_v<float>, halfWidth);
+        break;
+    }
+  }
+
+  for (size_t i = 0; i < segmentCount; ++i) {
+    const auto& start = points[i];
+    const auto& end = points[i + 1 == count ? 0 : i + 1];
+    const auto offset = segments.normal(i) * halfWidth;
+
+    append_triangle(out, start + offset, start - offset, end + offset);
+    append_triangle(out, end + offset, start - offset, end - offset);
+  }
+
+  const auto firstJoin = closed ? 0 : 1;
+  const auto lastJoin = closed ? count : count - 1;
+  for (size_t i = firstJoin; i < lastJoin; ++i) {
+    const auto previous = i == 0 ? segmentCount - 1 : i - 1;
+    append_join(out, points[i], segments.direction(previous),
+                segments.direction(i), style, halfWidth);
+  }
+}
+
+void tessellate_fill(ArrayProxy<const Point> points, std::vector<Point>& out) {
+  if (points.size() < 3) return;
+
+  const auto* p = points.data();
+
+  for (uint32 i = 1; i + 1 < points.size(); ++i) {
+    append_triangle(out, p[0], p[i], p[i + 1]);
+  }
+}
+
+}  // namespace muchcool::xgdi
@@ -0,0 +1,18 @@
+// Copyright (c) 2023 Jacob R. Green
+// All Rights Reserved.
+
+#pragma once
+
+#include "muchcool/xgdi/path.hpp"
+
+namespace muchcool::xgdi {
+
+// Appends a triangle list covering the stroke of the contour to `out`.
+void tessellate_stroke(ArrayProxy<const Point> points, bool closed,
+                       const StrokeStyle& style, std::vector<Point>& out);
+
+// Appends a triangle fan, expanded to a triangle list, covering the convex
+// contour to `out`.
+void tessellate_fill(ArrayProxy<const Point> points, std::vector<Point>& out);
+
+}  // namespace muchcool::xgdi
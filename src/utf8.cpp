@@ -0,0 +1,86 @@
+// Copyright (c) 2023 Jacob R. Green
+// All Rights Reserved.
+
+#include "utf8.hpp"
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define XGDI_UTF8_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace muchcool::xgdi {
+
+// Length of the run of ASCII bytes at the start of data.
+static size_t ascii_prefix(const uint8_t* data, size_t size) {
+  size_t i = 0;
+
+#if XGDI_UTF8_SSE2
+  for (; i + 16 <= size; i += 16) {
+    auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+    auto mask = static_cast<uint32_t>(_mm_movemask_epi8(chunk));
+    if (mask != 0) return i + std::countr_zero(mask);
+  }
+#endif
+
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, data + i, sizeof(word));
+    if (word & 0x8080808080808080ull) break;
+  }
+
+  while (i < size && data[i] < 0x80) ++i;
+  return i;
+}
+
+void decode_utf8(std::string_view text, std::vector<char32_t>& codes) {
+  auto data = reinterpret_cast<const uint8_t*>(text.data());
+  auto size = text.size();
+
+  codes.reserve(codes.size() + size);
+
+  size_t i = 0;
+  while (i < size) {
+    auto ascii = i + ascii_prefix(data + i, size - i);
+    codes.insert(codes.end(), data + i, data + ascii);
+    i = ascii;
+    if (i == size) break;
+
+    auto lead = data[i];
+    size_t length;
+    char32_t code;
+    char32_t min;
+
+    if ((lead & 0xE0) == 0xC0) {
+      length = 2, code = lead & 0x1F, min = 0x80;
+    } else if ((lead & 0xF0) == 0xE0) {
+      length = 3, code = lead & 0x0F, min = 0x800;
+    } else if ((lead & 0xF8) == 0xF0) {
+      length = 4, code = lead & 0x07, min = 0x10000;
+    } else {
+      // Stray continuation byte or invalid lead byte.
+      codes.push_back(REPLACEMENT_CHARACTER);
+      ++i;
+      continue;
+    }
+
+    size_t read = 1;
+    for (; read < length && i + read < size; ++read) {
+      auto byte = data[i + read];
+      if ((byte & 0xC0) != 0x80) break;
+      code = (code << 6) | (byte & 0x3F);
+    }
+
+    const auto valid = read == length && code >= min && code <= 0x10FFFF &&
+                       (code < 0xD800 || code > 0xDFFF);
+
+    codes.push_back(valid ? code : REPLACEMENT_CHARACTER);
+    i += read;
+  }
+}
+
+}  // namespace muchcool::xgdi
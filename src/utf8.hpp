@@ -0,0 +1,17 @@
+// Copyright (c) 2023 Jacob R. Green
+// All Rights Reserved.
+
+#pragma once
+
+#include <string_view>
+#include <vector>
+
+namespace muchcool::xgdi {
+
+constexpr char32_t REPLACEMENT_CHARACTER = 0xFFFD;
+
+// Appends the code points of the UTF-8 text to `codes`. Invalid, overlong
+// and truncated sequences decode to REPLACEMENT_CHARACTER.
+void decode_utf8(std::string_view text, std::vector<char32_t>& codes);
+
+}  // namespace muchcool::xgdi
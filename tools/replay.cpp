@@ -0,0 +1,195 @@
+// Copyright (c) 2023 Jacob R. Green
+// All Rights Reserved.
+
+// Replays a frame trace captured with DrawingContext::capture_frame and
+// reports recording and frame times.
+//
+//   xgdi_replay <trace> [--cpu] [--iterations <count>] [--output <image>]
+//
+// Frames are rendered on the headless offscreen target, or on the CPU
+// rasterizer with --cpu. The last frame is written to --output with DevIL.
+
+#include <muchcool/xgdi.hpp>
+
+#include "IL/il.h"
+#include "IL/ilu.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+
+using namespace muchcool;
+using namespace muchcool::xgdi;
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+  const char* Trace = nullptr;
+  const char* Output = nullptr;
+  bool Cpu = false;
+  uint32 Iterations = 100;
+};
+
+struct Timing {
+  double Min = std::numeric_limits<double>::infinity();
+  double Total = 0.0;
+
+  void add(double ms) {
+    Min = std::min(Min, ms);
+    Total += ms;
+  }
+};
+
+static double elapsed_ms(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+static void print_usage() {
+  std::fprintf(stderr,
+               "usage: xgdi_replay <trace> [--cpu] [--iterations <count>] "
+               "[--output <image>]\n");
+}
+
+static bool parse_options(int argc, char** argv, Options& options) {
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--cpu") == 0) {
+      options.Cpu = true;
+    } else if (std::strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+      options.Iterations = std::max(std::atoi(argv[++i]), 1);
+    } else if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+      options.Output = argv[++i];
+    } else if (!options.Trace && argv[i][0] != '-') {
+      options.Trace = argv[i];
+    } else {
+      return false;
+    }
+  }
+  return options.Trace != nullptr;
+}
+
+static void save_image(const char* path, uint32 width, uint32 height,
+                       const void* pixels) {
+  ilInit();
+  iluInit();
+
+  ILuint image;
+  ilGenImages(1, &image);
+  ilBindImage(image);
+
+  ilTexImage(width, height, 1, 4, IL_RGBA, IL_UNSIGNED_BYTE,
+             const_cast<void*>(pixels));
+  // Pixels are stored top row first, DevIL expects the bottom row first.
+  iluFlipImage();
+
+  ilEnable(IL_FILE_OVERWRITE);
+  if (ilSaveImage(path) == IL_FALSE) {
+    std::fprintf(stderr, "failed to save %s: %s\n", path,
+                 iluErrorString(ilGetError()));
+  }
+
+  ilDeleteImages(1, &image);
+}
+
+static void print_timing(const char* name, const Timing& timing,
+                         uint32 iterations) {
+  std::printf("%-10s avg %8.3f ms  min %8.3f ms\n", name,
+              timing.Total / iterations, timing.Min);
+}
+
+static int replay_gpu(FrameTrace& trace, const Options& options) {
+  auto context = Shared{new rndr::GraphicsContext()};
+  auto target =
+      Shared{new OffscreenTarget(context, trace.width(), trace.height())};
+  auto drawing = Shared{new DrawingContext(target)};
+  auto pixels = std::vector<uint8>(trace.width() * trace.height() * 4);
+
+  trace.load_resources(context);
+
+  auto recording = Timing{};
+  auto frame = Timing{};
+  auto gpu = Timing{};
+
+  for (uint32 i = 0; i < options.Iterations; ++i) {
+    auto start = Clock::now();
+
+    drawing->reset();
+    drawing->start_recording();
+    trace.replay(*drawing);
+    drawing->end_recording();
+    recording.add(elapsed_ms(start));
+
+    drawing->submit();
+    target->read_pixels(pixels).get();
+    frame.add(elapsed_ms(start));
+
+    gpu.add(drawing->frame_stats().GpuMs);
+  }
+
+  print_timing("recording", recording, options.Iterations);
+  print_timing("frame", frame, options.Iterations);
+  print_timing("gpu", gpu, options.Iterations);
+
+  if (options.Output) {
+    save_image(options.Output, trace.width(), trace.height(), pixels.data());
+  }
+  return 0;
+}
+
+static int replay_cpu(FrameTrace& trace, const Options& options) {
+  auto drawing =
+      Shared{new CpuDrawingContext(trace.width(), trace.height())};
+
+  trace.load_resources(nullptr);
+
+  auto recording = Timing{};
+  auto frame = Timing{};
+
+  for (uint32 i = 0; i < options.Iterations; ++i) {
+    auto start = Clock::now();
+
+    drawing->reset();
+    drawing->start_recording();
+    trace.replay(*drawing);
+    recording.add(elapsed_ms(start));
+
+    drawing->end_recording();
+    frame.add(elapsed_ms(start));
+  }
+
+  print_timing("recording", recording, options.Iterations);
+  print_timing("frame", frame, options.Iterations);
+
+  if (options.Output) {
+    save_image(options.Output, trace.width(), trace.height(),
+               drawing->pixels().data());
+  }
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  auto options = Options{};
+  if (!parse_options(argc, argv, options)) {
+    print_usage();
+    return 1;
+  }
+
+  try {
+    auto trace = FrameTrace::Load(options.Trace);
+
+    std::printf("%s: %ux%u, %u commands, %u iterations on the %s\n",
+                options.Trace, trace->width(), trace->height(),
+                trace->command_count(), options.Iterations,
+                options.Cpu ? "CPU" : "GPU");
+
+    return options.Cpu ? replay_cpu(*trace, options)
+                       : replay_gpu(*trace, options);
+  } catch (const std::exception& e) {
+    std::fprintf(stderr, "replay failed: %s\n", e.what());
+    return 1;
+  }
+}